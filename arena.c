@@ -0,0 +1,109 @@
+#pragma once
+
+// NOTE(Felix): Necessary includes
+// "language_layer.h"
+#include <sys/mman.h>
+
+// NOTE(Felix): Memory arena that reserves a big range of address space up front and only
+// commits (makes accessible) what is actually used. Because the range never moves,
+// pointers into the arena stay valid while it grows.
+// Reserving costs nothing but address space, committed pages only cost memory once touched.
+
+#define ARENA_COMMIT_GRANULARITY KIBIBYTES(256)
+
+typedef struct
+{
+	u8 *Base;
+	u64 Reserved;
+	u64 Committed;
+	u64 Used;
+} memory_arena;
+
+internal u64
+ArenaAlignUp(u64 Size, u64 Alignment)
+{
+	u64 Result = (Size + Alignment - 1) & ~(Alignment - 1);
+	return (Result);
+}
+
+internal b32
+ArenaReserve(memory_arena *Arena, u64 ReserveSize)
+{
+	MemoryClear(Arena, sizeof(*Arena));
+	ReserveSize = ArenaAlignUp(ReserveSize, ARENA_COMMIT_GRANULARITY);
+	void *Base = mmap(0, ReserveSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (Base == MAP_FAILED)
+	{
+		return (0);
+	}
+	Arena->Base = Base;
+	Arena->Reserved = ReserveSize;
+	return (1);
+}
+
+internal void
+ArenaRelease(memory_arena *Arena)
+{
+	if (Arena->Base)
+	{
+		munmap(Arena->Base, Arena->Reserved);
+	}
+	MemoryClear(Arena, sizeof(*Arena));
+}
+
+internal b32
+ArenaCommit(memory_arena *Arena, u64 Size)
+{
+	// NOTE(Felix): Makes sure at least Size bytes from the start are accessible.
+	// Returns 0 if that would exceed the reservation or the system is out of memory
+	if (Size <= Arena->Committed)
+	{
+		return (1);
+	}
+	if (Size > Arena->Reserved)
+	{
+		return (0);
+	}
+
+	u64 NewCommitted = MIN(ArenaAlignUp(Size, ARENA_COMMIT_GRANULARITY), Arena->Reserved);
+	if (0 != mprotect(Arena->Base + Arena->Committed, NewCommitted - Arena->Committed, PROT_READ|PROT_WRITE))
+	{
+		return (0);
+	}
+	Arena->Committed = NewCommitted;
+	return (1);
+}
+
+internal void *
+ArenaPush(memory_arena *Arena, u64 Size)
+{
+	void *Result = 0;
+	if (ArenaCommit(Arena, Arena->Used + Size))
+	{
+		Result = Arena->Base + Arena->Used;
+		Arena->Used += Size;
+	}
+	return (Result);
+}
+
+internal void
+ArenaReset(memory_arena *Arena)
+{
+	Arena->Used = 0;
+}
+
+internal void
+ArenaDecommitAbove(memory_arena *Arena, u64 KeepSize)
+{
+	// NOTE(Felix): Hands every page above KeepSize (or above what is in use, whatever is
+	// bigger) back to the system, the address range itself stays reserved
+	u64 NewCommitted = ArenaAlignUp(MAX(KeepSize, Arena->Used), ARENA_COMMIT_GRANULARITY);
+	if (NewCommitted < Arena->Committed)
+	{
+		u8 *Start = Arena->Base + NewCommitted;
+		u64 Size = Arena->Committed - NewCommitted;
+		madvise(Start, Size, MADV_DONTNEED);
+		mprotect(Start, Size, PROT_NONE);
+		Arena->Committed = NewCommitted;
+	}
+}
@@ -6,15 +6,25 @@
 // 'h'   - Leave directory
 // 'l'   - Enter directory / open file
 // 't'   - Toggle hidden files / directories
+// 'i'   - Toggle long listing: permissions, owner, size and modification time of every entry
+//         (also enabled by starting with "-l")
 // 'r'   - Refresh contents of current folder
+// 's'   - Toggle streaming: unsorted, only a window of the directory is kept in memory
+//         (for enormous directories, also enabled by starting with "-s")
 // 'd'   - Jump to top / first directory
 // 'f'   - Jump to first file
 // 'e'   - Jump to end
 // 'g'   - Jump to first entry starting with the following character (case insensitive)
 // '/'   - Search (case insensitive)
 // '?'   - Search (case sensitive)
+// 'z'   - Fuzzy search, best matches first (case insensitive unless the search has upper case letters)
+// 'p'   - Pattern search: a glob matching the whole name ("*.tmp", "core.[0-9]*"), or a
+//         regular expression if it starts with '^' ("^(foo|bar).*\.c$"), case like 'z'
+// 'm'   - Query by metadata, like "size>1G mtime<1h type=f perm=x", other words have to be
+//         part of the name (see metadata_query.c)
 // 'C-f' - Move a page forward
 // 'C-b' - Move a page backward
+// Arrow keys, page up / down, home and end work like 'hjkl', 'C-b' / 'C-f', 'd' and 'e'
 // 'C-w' - Clear but continue search
 // 'esc' - Clear search and enter browsing mode
 // 'q'   - Quit
@@ -6,6 +6,9 @@
 #include <stdio.h>
 #include <termios.h>
 #include <sys/ioctl.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
 
 // NOTE(Felix): Usefule stuff that one can copy over on need
 #if 0
@@ -156,3 +159,281 @@ ConsoleMoveCursorUp(i32 LinesToMove)
 {
 	printf("\033[%dA", LinesToMove);
 }
+
+// NOTE(Felix): Box drawing glyphs
+#define GLYPH_HORIZONTAL        "\u2550"
+#define GLYPH_VERTICAL          "\u2551"
+#define GLYPH_TOP_RIGHT         "\u2557"
+#define GLYPH_BOTTOM_LEFT       "\u255a"
+#define GLYPH_BOTTOM_RIGHT      "\u255d"
+#define GLYPH_VERTICAL_TO_RIGHT "\u255e"
+#define GLYPH_DOWN_FROM_DOUBLE  "\u2565"
+#define GLYPH_UP_FROM_DOUBLE    "\u2568"
+
+// NOTE(Felix): Output buffer. A frame gets built in memory and goes out with a single write,
+// more only if it doesn't fit into the buffer or the terminal takes it in pieces.
+// Escape sequences are formatted by hand, printf is too slow for thousands of them a frame.
+// Every frame records how long building it took and how many bytes and writes it cost.
+// If the terminal supports synchronized updates (DEC mode 2026) every frame is wrapped in
+// them, so the terminal shows it all at once instead of tearing halfway through
+#define CONSOLE_OUTPUT_BUFFER_SIZE KIBIBYTES(256)
+
+typedef struct
+{
+	u8 Data[CONSOLE_OUTPUT_BUFFER_SIZE];
+	u32 Used;
+	b32 UseSynchronizedUpdate;
+
+	u64 FrameStartNanoseconds;
+	u32 FrameWriteCount;
+	u64 FrameBytes;
+
+	u64 FrameCount;
+	u64 LastFrameBuildNanoseconds;
+	u32 LastFrameWriteCount;
+	u64 LastFrameBytes;
+	u64 TotalBuildNanoseconds;
+	u64 TotalWriteCount;
+	u64 TotalBytes;
+} console_output;
+
+internal u64
+ConsoleTimeGetNanoseconds(void)
+{
+	struct timespec Time = { 0 };
+	clock_gettime(CLOCK_MONOTONIC, &Time);
+	return ((u64)Time.tv_sec*1000000000 + (u64)Time.tv_nsec);
+}
+
+internal void
+ConsoleOutputSend(console_output *Output)
+{
+	// NOTE(Felix): The terminal may take less than we hand it, keep going until all is out
+	u32 Sent = 0;
+	while (Sent < Output->Used)
+	{
+		ssize_t Written = write(STDOUT_FILENO, Output->Data + Sent, Output->Used - Sent);
+		++Output->FrameWriteCount;
+		if (Written <= 0)
+		{
+			if (Written < 0 && (errno == EINTR || errno == EAGAIN))
+			{
+				continue;
+			}
+			break;
+		}
+		Sent += (u32)Written;
+	}
+	Output->FrameBytes += Output->Used;
+	Output->Used = 0;
+}
+
+internal void
+ConsoleOutputAppend(console_output *Output, void *Data, u32 Size)
+{
+	if (Output->Used + Size > CONSOLE_OUTPUT_BUFFER_SIZE)
+	{
+		ConsoleOutputSend(Output);
+	}
+	if (Size <= CONSOLE_OUTPUT_BUFFER_SIZE)
+	{
+		u8 *Source = Data;
+		u8 *Destination = Output->Data + Output->Used;
+		for (u32 Index = 0; Index < Size; ++Index)
+		{
+			Destination[Index] = Source[Index];
+		}
+		Output->Used += Size;
+	}
+}
+
+internal void
+ConsoleOutputAppendString(console_output *Output, char *String)
+{
+	ConsoleOutputAppend(Output, String, StringLength(String));
+}
+
+internal void
+ConsoleOutputAppendU32(console_output *Output, u32 Value)
+{
+	// NOTE(Felix): Digits come out backwards, so they're collected from the end of Digits
+	char Digits[10];
+	u32 DigitIndex = sizeof(Digits);
+	do
+	{
+		Digits[--DigitIndex] = (char)('0' + Value % 10);
+		Value /= 10;
+	} while (Value > 0);
+	ConsoleOutputAppend(Output, Digits + DigitIndex, (u32)sizeof(Digits) - DigitIndex);
+}
+
+internal void
+ConsoleOutputCursorMoveTo(console_output *Output, i32 Y, i32 X)
+{
+	// NOTE(Felix): Zero indexed like CursorMoveTo
+	ConsoleOutputAppend(Output, "\033[", 2);
+	ConsoleOutputAppendU32(Output, (u32)(Y+1));
+	ConsoleOutputAppend(Output, ";", 1);
+	ConsoleOutputAppendU32(Output, (u32)(X+1));
+	ConsoleOutputAppend(Output, "H", 1);
+}
+
+internal void
+ConsoleOutputColorSet(console_output *Output, u32 Foreground, u32 Background)
+{
+	ConsoleOutputAppend(Output, "\033[", 2);
+	ConsoleOutputAppendU32(Output, Background);
+	ConsoleOutputAppend(Output, ";", 1);
+	ConsoleOutputAppendU32(Output, Foreground);
+	ConsoleOutputAppend(Output, "m", 1);
+}
+
+internal void
+ConsoleOutputScreenClear(console_output *Output)
+{
+	ConsoleOutputAppend(Output, "\033[2J", 4);
+}
+
+internal void
+ConsoleOutputScrollRegionSet(console_output *Output, i32 Top, i32 Bottom)
+{
+	// NOTE(Felix): DECSTBM, rows Top to Bottom (zero indexed, inclusive) scroll on their own
+	ConsoleOutputAppend(Output, "\033[", 2);
+	ConsoleOutputAppendU32(Output, (u32)(Top+1));
+	ConsoleOutputAppend(Output, ";", 1);
+	ConsoleOutputAppendU32(Output, (u32)(Bottom+1));
+	ConsoleOutputAppend(Output, "r", 1);
+}
+
+internal void
+ConsoleOutputScrollRegionReset(console_output *Output)
+{
+	// NOTE(Felix): Also moves the cursor to the top left
+	ConsoleOutputAppend(Output, "\033[r", 3);
+}
+
+internal void
+ConsoleOutputIndex(console_output *Output)
+{
+	// NOTE(Felix): Cursor down, scrolls the region up if the cursor is at its bottom
+	ConsoleOutputAppend(Output, "\033D", 2);
+}
+
+internal void
+ConsoleOutputReverseIndex(console_output *Output)
+{
+	// NOTE(Felix): Cursor up, scrolls the region down if the cursor is at its top
+	ConsoleOutputAppend(Output, "\033M", 2);
+}
+
+internal void
+ConsoleOutputFrameBegin(console_output *Output)
+{
+	Output->FrameStartNanoseconds = ConsoleTimeGetNanoseconds();
+	Output->FrameWriteCount = 0;
+	Output->FrameBytes = 0;
+	if (Output->UseSynchronizedUpdate)
+	{
+		ConsoleOutputAppend(Output, "\033[?2026h", 8);
+	}
+}
+
+internal void
+ConsoleOutputFrameEnd(console_output *Output)
+{
+	// NOTE(Felix): Build time is everything up to handing the frame to the terminal.
+	// A frame that didn't change anything isn't sent at all
+	u64 BuildNanoseconds = ConsoleTimeGetNanoseconds() - Output->FrameStartNanoseconds;
+	if (Output->UseSynchronizedUpdate)
+	{
+		if (Output->Used == 8 && Output->FrameBytes == 0)
+		{
+			Output->Used = 0;
+		}
+		else
+		{
+			ConsoleOutputAppend(Output, "\033[?2026l", 8);
+		}
+	}
+	ConsoleOutputSend(Output);
+
+	++Output->FrameCount;
+	Output->LastFrameBuildNanoseconds = BuildNanoseconds;
+	Output->LastFrameWriteCount = Output->FrameWriteCount;
+	Output->LastFrameBytes = Output->FrameBytes;
+	Output->TotalBuildNanoseconds += BuildNanoseconds;
+	Output->TotalWriteCount += Output->FrameWriteCount;
+	Output->TotalBytes += Output->FrameBytes;
+}
+
+internal b32
+ConsoleSynchronizedUpdateQuery(void)
+{
+	// NOTE(Felix): Asks the terminal whether it supports mode 2026 (DECRQM). Terminals that
+	// don't know DECRQM stay silent, so we ask for the device attributes (DA1) right after,
+	// every terminal answers that one. Input has to be unbuffered already, anything typed
+	// while we wait for the answer is lost
+	if (0 == isatty(STDIN_FILENO) || 0 == isatty(STDOUT_FILENO))
+	{
+		return (0);
+	}
+	printf("\033[?2026$p\033[c");
+
+	b32 Result = 0;
+	char Response[256];
+	u32 ResponseLength = 0;
+	u64 Deadline = ConsoleTimeGetNanoseconds() + 250000000;
+	for (;;)
+	{
+		u64 Now = ConsoleTimeGetNanoseconds();
+		struct pollfd PollRequest = { 0 };
+		PollRequest.fd = STDIN_FILENO;
+		PollRequest.events = POLLIN;
+		if (Now >= Deadline || poll(&PollRequest, 1, (int)((Deadline - Now) / 1000000) + 1) <= 0 ||
+		    ResponseLength == sizeof(Response))
+		{
+			break;
+		}
+		ssize_t BytesRead = read(STDIN_FILENO, Response + ResponseLength, sizeof(Response) - ResponseLength);
+		if (BytesRead <= 0)
+		{
+			break;
+		}
+		ResponseLength += (u32)BytesRead;
+
+		// NOTE(Felix): Answers look like "ESC [ ? 2026 ; <state> $ y" and "ESC [ ? <attributes> c",
+		// state 1 or 2 means supported (set or reset)
+		b32 ReceivedAttributes = 0;
+		for (u32 Index = 0; Index+2 < ResponseLength; ++Index)
+		{
+			if (Response[Index] != '\033' || Response[Index+1] != '[' || Response[Index+2] != '?')
+			{
+				continue;
+			}
+			u32 End = Index+3;
+			while (End < ResponseLength && (Response[End] < 0x40 || Response[End] > 0x7e))
+			{
+				++End;
+			}
+			if (End == ResponseLength)
+			{
+				break;
+			}
+			if (Response[End] == 'y' && End - Index == 10 &&
+			    Response[Index+3] == '2' && Response[Index+4] == '0' && Response[Index+5] == '2' && 
+			    Response[Index+6] == '6' && Response[Index+7] == ';')
+			{
+				Result = (Response[Index+8] == '1' || Response[Index+8] == '2');
+			}
+			if (Response[End] == 'c')
+			{
+				ReceivedAttributes = 1;
+			}
+		}
+		if (ReceivedAttributes)
+		{
+			break;
+		}
+	}
+	return (Result);
+}
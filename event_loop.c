@@ -0,0 +1,166 @@
+#pragma once
+
+// NOTE(Felix): Necessary includes
+// "language_layer.h"
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+
+// NOTE(Felix): Everything the main loop waits for goes through one epoll descriptor:
+//  - input (the terminal)
+//  - signals, through a signalfd. SIGWINCH, SIGINT and SIGCHLD are blocked for the whole
+//    process (threads started afterwards inherit that), so they only ever show up here and
+//    no signal handler runs in the middle of anything. Child processes have to unblock them
+//    again, see EventLoopChildPrepare
+//  - a timerfd, for the next frame being due (see EventLoopTimerSet)
+//  - an eventfd, any thread can wake the loop through it, see EventLoopWake
+// EventLoopCreate has to run before any thread is started
+typedef enum
+{
+	EVENT_SOURCE_INPUT,
+	EVENT_SOURCE_SIGNAL,
+	EVENT_SOURCE_TIMER,
+	EVENT_SOURCE_WAKE,
+} event_source;
+
+typedef struct
+{
+	i32 EpollFileDescriptor;
+	i32 SignalFileDescriptor;
+	i32 TimerFileDescriptor;
+	i32 WakeFileDescriptor;
+} event_loop;
+
+// NOTE(Felix): What happened since the last wait
+typedef struct
+{
+	b32 InputIsReady;
+	b32 WasResized;
+	b32 WasInterrupted;
+	b32 ChildExited;
+	b32 TimerExpired;
+	b32 WasWokenUp;
+} event_loop_events;
+
+internal void
+EventLoopSignalSetGet(sigset_t *Signals)
+{
+	sigemptyset(Signals);
+	sigaddset(Signals, SIGWINCH);
+	sigaddset(Signals, SIGINT);
+	sigaddset(Signals, SIGCHLD);
+}
+
+internal void
+EventLoopChildPrepare(void)
+{
+	// NOTE(Felix): Call in a forked child before exec, it shouldn't start out with our
+	// signals blocked
+	sigset_t Signals;
+	EventLoopSignalSetGet(&Signals);
+	sigprocmask(SIG_UNBLOCK, &Signals, 0);
+}
+
+internal void
+EventLoopChildRestore(void)
+{
+	// NOTE(Felix): If the exec after EventLoopChildPrepare failed and we're not in a forked
+	// child, the signals have to be blocked again or the event loop never sees them
+	sigset_t Signals;
+	EventLoopSignalSetGet(&Signals);
+	sigprocmask(SIG_BLOCK, &Signals, 0);
+}
+
+internal b32
+EventLoopAdd(event_loop *Loop, i32 FileDescriptor, event_source Source)
+{
+	struct epoll_event Event = { 0 };
+	Event.events = EPOLLIN;
+	Event.data.u32 = Source;
+	return (0 == epoll_ctl(Loop->EpollFileDescriptor, EPOLL_CTL_ADD, FileDescriptor, &Event));
+}
+
+internal b32
+EventLoopCreate(event_loop *Loop, i32 InputFileDescriptor)
+{
+	sigset_t Signals;
+	EventLoopSignalSetGet(&Signals);
+	pthread_sigmask(SIG_BLOCK, &Signals, 0);
+
+	Loop->EpollFileDescriptor = epoll_create1(EPOLL_CLOEXEC);
+	Loop->SignalFileDescriptor = signalfd(-1, &Signals, SFD_NONBLOCK | SFD_CLOEXEC);
+	Loop->TimerFileDescriptor = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	Loop->WakeFileDescriptor = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	b32 Result = (Loop->EpollFileDescriptor >= 0 && Loop->SignalFileDescriptor >= 0 &&
+	              Loop->TimerFileDescriptor >= 0 && Loop->WakeFileDescriptor >= 0);
+	Result = Result && EventLoopAdd(Loop, InputFileDescriptor, EVENT_SOURCE_INPUT);
+	Result = Result && EventLoopAdd(Loop, Loop->SignalFileDescriptor, EVENT_SOURCE_SIGNAL);
+	Result = Result && EventLoopAdd(Loop, Loop->TimerFileDescriptor, EVENT_SOURCE_TIMER);
+	Result = Result && EventLoopAdd(Loop, Loop->WakeFileDescriptor, EVENT_SOURCE_WAKE);
+	return (Result);
+}
+
+internal void
+EventLoopTimerSet(event_loop *Loop, i32 Milliseconds)
+{
+	// NOTE(Felix): One shot, a new time replaces the old one. 0 or less disarms it
+	struct itimerspec Timer = { 0 };
+	if (Milliseconds > 0)
+	{
+		Timer.it_value.tv_sec = Milliseconds / 1000;
+		Timer.it_value.tv_nsec = (long)(Milliseconds % 1000) * 1000000;
+	}
+	timerfd_settime(Loop->TimerFileDescriptor, 0, &Timer, 0);
+}
+
+internal void
+EventLoopWake(event_loop *Loop)
+{
+	// NOTE(Felix): Safe to call from any thread
+	u64 One = 1;
+	ssize_t Written = write(Loop->WakeFileDescriptor, &One, sizeof(One));
+	(void)Written;
+}
+
+internal void
+EventLoopWait(event_loop *Loop, i32 TimeoutMilliseconds, event_loop_events *Events)
+{
+	// NOTE(Felix): Waits until anything happens (or the timeout passes, -1 waits forever)
+	// and fills in Events. Signals, timer and wake ups are consumed here, input isn't
+	MemoryClear(Events, sizeof(*Events));
+	struct epoll_event Ready[8];
+	i32 ReadyCount = epoll_wait(Loop->EpollFileDescriptor, Ready, (i32)ARRAYCOUNT(Ready), TimeoutMilliseconds);
+	for (i32 ReadyIndex = 0; ReadyIndex < ReadyCount; ++ReadyIndex)
+	{
+		switch (Ready[ReadyIndex].data.u32)
+		{
+			case EVENT_SOURCE_INPUT: {
+				Events->InputIsReady = 1;
+			} break;
+
+			case EVENT_SOURCE_SIGNAL: {
+				struct signalfd_siginfo Info;
+				while (read(Loop->SignalFileDescriptor, &Info, sizeof(Info)) == (ssize_t)sizeof(Info))
+				{
+					if (Info.ssi_signo == SIGWINCH) { Events->WasResized = 1; }
+					if (Info.ssi_signo == SIGINT)   { Events->WasInterrupted = 1; }
+					if (Info.ssi_signo == SIGCHLD)  { Events->ChildExited = 1; }
+				}
+			} break;
+
+			case EVENT_SOURCE_TIMER: {
+				u64 Expirations = 0;
+				Events->TimerExpired = (read(Loop->TimerFileDescriptor, &Expirations, sizeof(Expirations)) > 0);
+			} break;
+
+			case EVENT_SOURCE_WAKE: {
+				u64 WakeCount = 0;
+				Events->WasWokenUp = (read(Loop->WakeFileDescriptor, &WakeCount, sizeof(WakeCount)) > 0);
+			} break;
+		}
+	}
+}
@@ -0,0 +1,219 @@
+#pragma once
+
+// NOTE(Felix): Necessary includes
+// "language_layer.h"
+
+// NOTE(Felix): Fuzzy matching, the pattern's characters have to show up in the name in order
+// but not necessarily next to each other (like fzf). Every match gets a score:
+//  - every matched character scores, gaps in between cost
+//  - characters right after a word boundary (start of the name, after '.', '_', ' ', ...,
+//    a lower to upper case or letter to digit change) get a bonus
+//  - consecutive characters keep the bonus of the first one of their run
+//  - the bonus of the first pattern character counts double, matching right at the start
+//    of the name gets another bonus on top
+// The match that gets scored is found like fzf's v1 algorithm does: scan forward for the
+// first position where the whole pattern has matched, then backward from there to find the
+// shortest match ending there.
+//
+// Before any of that, candidates get rejected by their character mask: one bit per letter
+// (case folded) and a few buckets for everything else. If the pattern has a bit the name
+// doesn't, the name can't match. Masks of names are computed once when they're loaded.
+//
+// Smart case: the pattern is case insensitive unless it contains an upper case letter.
+#define FUZZY_MAX_PATTERN_LENGTH 256
+#define FUZZY_NO_MATCH (-0x7fffffff)
+
+#define FUZZY_SCORE_MATCH 16
+#define FUZZY_SCORE_GAP_START (-3)
+#define FUZZY_SCORE_GAP_EXTENSION (-1)
+#define FUZZY_BONUS_BOUNDARY (FUZZY_SCORE_MATCH / 2)
+#define FUZZY_BONUS_NON_WORD (FUZZY_SCORE_MATCH / 2)
+#define FUZZY_BONUS_CAMEL_123 (FUZZY_BONUS_BOUNDARY + FUZZY_SCORE_GAP_EXTENSION)
+#define FUZZY_BONUS_CONSECUTIVE (-(FUZZY_SCORE_GAP_START + FUZZY_SCORE_GAP_EXTENSION))
+#define FUZZY_BONUS_FIRST_CHAR_MULTIPLIER 2
+#define FUZZY_BONUS_PREFIX FUZZY_SCORE_MATCH
+
+typedef enum
+{
+	FUZZY_CHAR_CLASS_NON_WORD,
+	FUZZY_CHAR_CLASS_LOWER,
+	FUZZY_CHAR_CLASS_UPPER,
+	FUZZY_CHAR_CLASS_DIGIT,
+} fuzzy_char_class;
+
+typedef struct
+{
+	u8 Pattern[FUZZY_MAX_PATTERN_LENGTH]; // Already folded if case insensitive
+	u32 Length;
+	b32 IsCaseSensitive;
+	u32 CharMask;
+} fuzzy_pattern;
+
+internal u32
+FuzzyCharBit(u8 Char)
+{
+	// NOTE(Felix): Bits 0-25 for letters (either case), the rest are buckets
+	u32 Bit = 31;
+	if (Char >= 'a' && Char <= 'z')      { Bit = (u32)(Char - 'a'); }
+	else if (Char >= 'A' && Char <= 'Z') { Bit = (u32)(Char - 'A'); }
+	else if (Char >= '0' && Char <= '4') { Bit = 26; }
+	else if (Char >= '5' && Char <= '9') { Bit = 27; }
+	else if (Char == '.')                { Bit = 28; }
+	else if (Char == '_')                { Bit = 29; }
+	else if (Char == '-')                { Bit = 30; }
+	return (1u << Bit);
+}
+
+internal u32
+FuzzyCharMask(char *String, u32 Length)
+{
+	u32 Mask = 0;
+	for (u32 Index = 0; Index < Length; ++Index)
+	{
+		Mask |= FuzzyCharBit((u8)String[Index]);
+	}
+	return (Mask);
+}
+
+internal fuzzy_char_class
+FuzzyCharClass(u8 Char)
+{
+	fuzzy_char_class Result = FUZZY_CHAR_CLASS_NON_WORD;
+	if (Char >= 'a' && Char <= 'z')      { Result = FUZZY_CHAR_CLASS_LOWER; }
+	else if (Char >= 'A' && Char <= 'Z') { Result = FUZZY_CHAR_CLASS_UPPER; }
+	else if (Char >= '0' && Char <= '9') { Result = FUZZY_CHAR_CLASS_DIGIT; }
+	else if (Char >= 0x80)               { Result = FUZZY_CHAR_CLASS_LOWER; } // NOTE(Felix): Part of a UTF-8 sequence, treat it like a letter
+	return (Result);
+}
+
+internal i32
+FuzzyBonus(fuzzy_char_class PreviousClass, fuzzy_char_class Class)
+{
+	i32 Bonus = 0;
+	if (PreviousClass == FUZZY_CHAR_CLASS_NON_WORD && Class != FUZZY_CHAR_CLASS_NON_WORD)
+	{
+		Bonus = FUZZY_BONUS_BOUNDARY;
+	}
+	else if ((PreviousClass == FUZZY_CHAR_CLASS_LOWER && Class == FUZZY_CHAR_CLASS_UPPER) ||
+	         (PreviousClass != FUZZY_CHAR_CLASS_DIGIT && Class == FUZZY_CHAR_CLASS_DIGIT))
+	{
+		Bonus = FUZZY_BONUS_CAMEL_123;
+	}
+	else if (Class == FUZZY_CHAR_CLASS_NON_WORD)
+	{
+		Bonus = FUZZY_BONUS_NON_WORD;
+	}
+	return (Bonus);
+}
+
+internal void
+FuzzyPatternInit(fuzzy_pattern *Pattern, char *String)
+{
+	u32 Length = MIN(StringLength(String), FUZZY_MAX_PATTERN_LENGTH-1);
+	b32 IsCaseSensitive = 0;
+	for (u32 Index = 0; Index < Length; ++Index)
+	{
+		IsCaseSensitive |= (String[Index] >= 'A' && String[Index] <= 'Z');
+	}
+
+	for (u32 Index = 0; Index < Length; ++Index)
+	{
+		Pattern->Pattern[Index] = IsCaseSensitive ? (u8)String[Index] : (u8)CharToLowerIfIsLetter(String[Index]);
+	}
+	Pattern->Pattern[Length] = 0;
+	Pattern->Length = Length;
+	Pattern->IsCaseSensitive = IsCaseSensitive;
+	Pattern->CharMask = FuzzyCharMask(String, Length);
+}
+
+internal b32
+FuzzyMaskCanMatch(fuzzy_pattern *Pattern, u32 CharMask)
+{
+	return (0 == (Pattern->CharMask & ~CharMask));
+}
+
+internal i32
+FuzzyScore(fuzzy_pattern *Pattern, char *String, u32 Length)
+{
+	// NOTE(Felix): Returns FUZZY_NO_MATCH if the pattern isn't a subsequence of String
+	u32 PatternLength = Pattern->Length;
+	if (PatternLength == 0)
+	{
+		return (0);
+	}
+
+	// NOTE(Felix): Forward: where does the first complete match end?
+	u32 PatternIndex = 0;
+	u32 End = 0;
+	for (u32 Index = 0; Index < Length; ++Index)
+	{
+		u8 Char = Pattern->IsCaseSensitive ? (u8)String[Index] : (u8)CharToLowerIfIsLetter(String[Index]);
+		if (Char == Pattern->Pattern[PatternIndex])
+		{
+			if (++PatternIndex == PatternLength)
+			{
+				End = Index + 1;
+				break;
+			}
+		}
+	}
+	if (PatternIndex < PatternLength)
+	{
+		return (FUZZY_NO_MATCH);
+	}
+
+	// NOTE(Felix): Backward: the shortest match that ends there
+	u32 Start = End;
+	PatternIndex = PatternLength;
+	while (PatternIndex > 0)
+	{
+		--Start;
+		u8 Char = Pattern->IsCaseSensitive ? (u8)String[Start] : (u8)CharToLowerIfIsLetter(String[Start]);
+		if (Char == Pattern->Pattern[PatternIndex-1])
+		{
+			--PatternIndex;
+		}
+	}
+
+	// NOTE(Felix): Score that range
+	i32 Score = (Start == 0) ? FUZZY_BONUS_PREFIX : 0;
+	i32 FirstBonus = 0;
+	u32 Consecutive = 0;
+	b32 InGap = 0;
+	fuzzy_char_class PreviousClass = (Start > 0) ? FuzzyCharClass((u8)String[Start-1]) : FUZZY_CHAR_CLASS_NON_WORD;
+	for (u32 Index = Start; Index < End; ++Index)
+	{
+		u8 Char = Pattern->IsCaseSensitive ? (u8)String[Index] : (u8)CharToLowerIfIsLetter(String[Index]);
+		fuzzy_char_class Class = FuzzyCharClass((u8)String[Index]);
+		if (PatternIndex < PatternLength && Char == Pattern->Pattern[PatternIndex])
+		{
+			i32 Bonus = FuzzyBonus(PreviousClass, Class);
+			if (Consecutive == 0)
+			{
+				FirstBonus = Bonus;
+			}
+			else
+			{
+				if (Bonus >= FUZZY_BONUS_BOUNDARY && Bonus > FirstBonus)
+				{
+					FirstBonus = Bonus;
+				}
+				Bonus = MAX(MAX(Bonus, FirstBonus), FUZZY_BONUS_CONSECUTIVE);
+			}
+
+			Score += FUZZY_SCORE_MATCH + ((PatternIndex == 0) ? Bonus*FUZZY_BONUS_FIRST_CHAR_MULTIPLIER : Bonus);
+			InGap = 0;
+			++Consecutive;
+			++PatternIndex;
+		}
+		else
+		{
+			Score += InGap ? FUZZY_SCORE_GAP_EXTENSION : FUZZY_SCORE_GAP_START;
+			InGap = 1;
+			Consecutive = 0;
+			FirstBonus = 0;
+		}
+		PreviousClass = Class;
+	}
+	return (Score);
+}
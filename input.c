@@ -0,0 +1,263 @@
+#pragma once
+
+// NOTE(Felix): Necessary includes
+// "language_layer.h"
+#include <unistd.h>
+#include <poll.h>
+#include <errno.h>
+
+// NOTE(Felix): Input. Everything the terminal has sent is read at once into a ring buffer and
+// decoded into a queue of key events. Escape sequences of special keys (arrows, page up /
+// down, home, end, ...) become one event each, unknown sequences are dropped instead of ending
+// up as typed characters. A lone ESC can't be told apart from the start of a sequence until
+// the rest of it arrives, so if the input ends in the middle of one we wait a moment for more
+// (INPUT_ESCAPE_TIMEOUT_MS) before taking it as it is.
+// Runs of the same motion key are collapsed into one event with a count, so a few hundred
+// queued 'j' cost one move and one frame, see InputKeyIsMotion
+#define INPUT_RING_SIZE 4096
+#define INPUT_MAX_EVENTS 1024
+#define INPUT_ESCAPE_TIMEOUT_MS 25
+#define INPUT_MAX_SEQUENCE_LENGTH 16
+
+// NOTE(Felix): Keys below 256 are the byte itself
+typedef enum
+{
+	INPUT_KEY_UP = 0x100,
+	INPUT_KEY_DOWN,
+	INPUT_KEY_RIGHT,
+	INPUT_KEY_LEFT,
+	INPUT_KEY_HOME,
+	INPUT_KEY_END,
+	INPUT_KEY_PAGE_UP,
+	INPUT_KEY_PAGE_DOWN,
+	INPUT_KEY_DELETE,
+} input_key;
+
+typedef struct
+{
+	i32 Key;
+	u32 Count;
+} input_event;
+
+typedef struct
+{
+	u8 Ring[INPUT_RING_SIZE];
+	u32 ReadIndex;  // Both only ever count up, the ring index is the lower bits
+	u32 WriteIndex;
+
+	input_event Events[INPUT_MAX_EVENTS];
+	u32 EventReadIndex;
+	u32 EventWriteIndex;
+} input_buffer;
+
+internal u32
+InputRingCount(input_buffer *Input)
+{
+	return (Input->WriteIndex - Input->ReadIndex);
+}
+
+internal u8
+InputRingPeek(input_buffer *Input, u32 Offset)
+{
+	return (Input->Ring[(Input->ReadIndex + Offset) % INPUT_RING_SIZE]);
+}
+
+internal b32
+InputKeyIsMotion(i32 Key)
+{
+	// NOTE(Felix): Keys that only ever move the selection, repeating them just moves further
+	return (Key == 'j' || Key == 'k' || Key == 6 || Key == 2 || // 6: CTRL-F, 2: CTRL-B
+	        Key == INPUT_KEY_UP || Key == INPUT_KEY_DOWN ||
+	        Key == INPUT_KEY_PAGE_UP || Key == INPUT_KEY_PAGE_DOWN);
+}
+
+internal b32
+InputEventIsPending(input_buffer *Input)
+{
+	return (Input->EventReadIndex != Input->EventWriteIndex);
+}
+
+internal u32
+InputSequenceDecode(input_buffer *Input, u32 Available, b32 IsComplete, i32 *Key)
+{
+	// NOTE(Felix): Decodes the key at the start of the ring. Returns how many bytes it took,
+	// 0 if it may be the start of a sequence that hasn't fully arrived yet (and IsComplete
+	// isn't set). Unknown sequences come out with Key -1
+	u8 First = InputRingPeek(Input, 0);
+	*Key = First;
+	if (First != 27 || Available == 1)
+	{
+		return ((First == 27 && 0 == IsComplete) ? 0 : 1);
+	}
+
+	u8 Introducer = InputRingPeek(Input, 1);
+	if (Introducer == 'O')
+	{
+		// NOTE(Felix): SS3, application cursor keys: ESC O <final>
+		if (Available < 3)
+		{
+			return (IsComplete ? 1 : 0);
+		}
+		switch (InputRingPeek(Input, 2))
+		{
+			case 'A': { *Key = INPUT_KEY_UP; } break;
+			case 'B': { *Key = INPUT_KEY_DOWN; } break;
+			case 'C': { *Key = INPUT_KEY_RIGHT; } break;
+			case 'D': { *Key = INPUT_KEY_LEFT; } break;
+			case 'H': { *Key = INPUT_KEY_HOME; } break;
+			case 'F': { *Key = INPUT_KEY_END; } break;
+			default:  { *Key = -1; } break;
+		}
+		return (3);
+	}
+	if (Introducer != '[')
+	{
+		// NOTE(Felix): ESC followed by anything else is just ESC, the rest comes next
+		return (1);
+	}
+
+	// NOTE(Felix): CSI: ESC [ <parameter bytes> <intermediate bytes> <final byte>
+	u32 Length = 2;
+	u32 Parameter = 0;
+	while (Length < Available && Length < INPUT_MAX_SEQUENCE_LENGTH)
+	{
+		u8 Byte = InputRingPeek(Input, Length++);
+		if (Byte >= '0' && Byte <= '9')
+		{
+			Parameter = Parameter*10 + (u32)(Byte - '0');
+		}
+		else if (Byte >= 0x40 && Byte <= 0x7e)
+		{
+			*Key = -1;
+			switch (Byte)
+			{
+				case 'A': { *Key = INPUT_KEY_UP; } break;
+				case 'B': { *Key = INPUT_KEY_DOWN; } break;
+				case 'C': { *Key = INPUT_KEY_RIGHT; } break;
+				case 'D': { *Key = INPUT_KEY_LEFT; } break;
+				case 'H': { *Key = INPUT_KEY_HOME; } break;
+				case 'F': { *Key = INPUT_KEY_END; } break;
+				case '~': {
+					switch (Parameter)
+					{
+						case 1: case 7: { *Key = INPUT_KEY_HOME; } break;
+						case 4: case 8: { *Key = INPUT_KEY_END; } break;
+						case 3: { *Key = INPUT_KEY_DELETE; } break;
+						case 5: { *Key = INPUT_KEY_PAGE_UP; } break;
+						case 6: { *Key = INPUT_KEY_PAGE_DOWN; } break;
+					}
+				} break;
+			}
+			return (Length);
+		}
+		else if (Byte < 0x20 || Byte > 0x3f)
+		{
+			// NOTE(Felix): Not a sequence after all, ESC on its own
+			return (1);
+		}
+	}
+
+	// NOTE(Felix): Ran out of input (or the sequence is too long to be anything we know)
+	if (Length >= INPUT_MAX_SEQUENCE_LENGTH)
+	{
+		*Key = -1;
+		return (Length);
+	}
+	return (IsComplete ? 1 : 0);
+}
+
+internal void
+InputDecode(input_buffer *Input, b32 IsComplete)
+{
+	// NOTE(Felix): Moves whatever can be decoded from the ring into the event queue
+	while (InputRingCount(Input) > 0 && Input->EventWriteIndex - Input->EventReadIndex < INPUT_MAX_EVENTS)
+	{
+		i32 Key = 0;
+		u32 Length = InputSequenceDecode(Input, InputRingCount(Input), IsComplete, &Key);
+		if (Length == 0)
+		{
+			break;
+		}
+		Input->ReadIndex += Length;
+		if (Key < 0)
+		{
+			continue;
+		}
+
+		input_event *Last = &Input->Events[(Input->EventWriteIndex-1) % INPUT_MAX_EVENTS];
+		if (InputEventIsPending(Input) && Last->Key == Key && InputKeyIsMotion(Key))
+		{
+			++Last->Count;
+		}
+		else
+		{
+			input_event *Event = &Input->Events[Input->EventWriteIndex++ % INPUT_MAX_EVENTS];
+			Event->Key = Key;
+			Event->Count = 1;
+		}
+	}
+}
+
+internal b32
+InputReadAvailable(input_buffer *Input, i32 FileDescriptor)
+{
+	// NOTE(Felix): Reads what's there without blocking. Returns 0 once there's nothing to read
+	// anymore (or the ring is full)
+	struct pollfd PollRequest = { 0 };
+	PollRequest.fd = FileDescriptor;
+	PollRequest.events = POLLIN;
+	u32 Free = INPUT_RING_SIZE - InputRingCount(Input);
+	if (Free == 0 || poll(&PollRequest, 1, 0) <= 0)
+	{
+		return (0);
+	}
+
+	// NOTE(Felix): Up to the end of the ring, the rest goes in with the next read
+	u32 WriteOffset = Input->WriteIndex % INPUT_RING_SIZE;
+	u32 Contiguous = MIN(Free, INPUT_RING_SIZE - WriteOffset);
+	ssize_t BytesRead = read(FileDescriptor, Input->Ring + WriteOffset, Contiguous);
+	if (BytesRead <= 0)
+	{
+		return (BytesRead < 0 && errno == EINTR);
+	}
+	Input->WriteIndex += (u32)BytesRead;
+	return (1);
+}
+
+internal void
+InputRead(input_buffer *Input, i32 FileDescriptor)
+{
+	// NOTE(Felix): Call once the descriptor is readable. Reads everything there is and decodes
+	// it, waiting a moment if it ends in an unfinished escape sequence
+	while (InputReadAvailable(Input, FileDescriptor))
+	{
+		InputDecode(Input, 0);
+	}
+	InputDecode(Input, 0);
+
+	if (InputRingCount(Input) > 0)
+	{
+		struct pollfd PollRequest = { 0 };
+		PollRequest.fd = FileDescriptor;
+		PollRequest.events = POLLIN;
+		if (poll(&PollRequest, 1, INPUT_ESCAPE_TIMEOUT_MS) > 0)
+		{
+			while (InputReadAvailable(Input, FileDescriptor))
+			{
+				InputDecode(Input, 0);
+			}
+		}
+		InputDecode(Input, 1);
+	}
+}
+
+internal b32
+InputEventNext(input_buffer *Input, input_event *Event)
+{
+	if (0 == InputEventIsPending(Input))
+	{
+		return (0);
+	}
+	*Event = Input->Events[Input->EventReadIndex++ % INPUT_MAX_EVENTS];
+	return (1);
+}
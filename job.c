@@ -0,0 +1,386 @@
+#pragma once
+
+// NOTE(Felix): Necessary includes
+// "language_layer.h"
+// "console.c"
+// "event_loop.c"
+#include <pthread.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <time.h>
+#include <sys/mman.h>
+
+// NOTE(Felix): Background jobs. A fixed pool of workers takes submitted jobs in order and runs
+// them, finished jobs go onto a lock free completion queue. The UI thread drains that once
+// per frame (JobSystemDrain), which calls every job's Complete on the UI thread, so the
+// results can be used without any locking.
+// Every job carries its own cancellation token: JobCancel only sets it. A job that hasn't
+// started yet is skipped, a running one should check JobIsCancelled now and then and stop
+// early. Either way the job is completed like any other (Complete sees WasRun and
+// IsCancelled), only after that it belongs to its owner again and may be freed or reused.
+// The completion queue is a stack that workers push onto with a compare and swap, draining
+// takes the whole stack at once (so there is no ABA problem) and reverses it into the order
+// jobs finished in. Only the push that finds the stack empty wakes the event loop, the drain
+// picks up whatever follows anyway.
+// Workers live as long as the program, like the filter pool.
+// "--job-stress" (JobStressRun) floods a pool of its own and checks every job got completed
+// exactly once.
+#define JOB_MAX_WORKERS 8
+
+typedef struct job job;
+typedef void job_function(job *Job);
+
+struct job
+{
+	job_function *Run;      // On a worker
+	job_function *Complete; // On the thread calling JobSystemDrain, may be 0
+	void *Data;
+
+	// NOTE(Felix): Set by the job system, IsCancelled is accessed atomically
+	u32 IsCancelled;
+	b32 WasRun;
+	job *Next;
+};
+
+typedef struct
+{
+	pthread_t Workers[JOB_MAX_WORKERS];
+	u32 WorkerCount;
+
+	// NOTE(Felix): Jobs waiting for a worker
+	pthread_mutex_t Mutex;
+	pthread_cond_t JobAvailable;
+	job *QueueFirst;
+	job *QueueLast;
+
+	// NOTE(Felix): Finished jobs, newest first. Accessed atomically
+	job *Completed;
+
+	event_loop *WakeLoop;
+	u64 SubmittedCount;
+	u64 CompletedCount;
+} job_system;
+
+internal void
+JobCancel(job *Job)
+{
+	__atomic_store_n(&Job->IsCancelled, 1, __ATOMIC_RELAXED);
+}
+
+internal b32
+JobIsCancelled(job *Job)
+{
+	return (__atomic_load_n(&Job->IsCancelled, __ATOMIC_RELAXED) != 0);
+}
+
+internal void
+JobCompletedPush(job_system *System, job *Job)
+{
+	job *Head = __atomic_load_n(&System->Completed, __ATOMIC_RELAXED);
+	do
+	{
+		Job->Next = Head;
+	} while (0 == __atomic_compare_exchange_n(&System->Completed, &Head, Job, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+	if (0 == Head && System->WakeLoop)
+	{
+		EventLoopWake(System->WakeLoop);
+	}
+}
+
+internal void *
+JobWorkerThread(void *Parameter)
+{
+	job_system *System = Parameter;
+	for (;;)
+	{
+		pthread_mutex_lock(&System->Mutex);
+		while (0 == System->QueueFirst)
+		{
+			pthread_cond_wait(&System->JobAvailable, &System->Mutex);
+		}
+		job *Job = System->QueueFirst;
+		System->QueueFirst = Job->Next;
+		if (0 == System->QueueFirst)
+		{
+			System->QueueLast = 0;
+		}
+		pthread_mutex_unlock(&System->Mutex);
+
+		if (0 == JobIsCancelled(Job))
+		{
+			Job->Run(Job);
+			Job->WasRun = 1;
+		}
+		JobCompletedPush(System, Job);
+	}
+	return (0);
+}
+
+internal void
+JobSystemStart(job_system *System, u32 WorkerCount, event_loop *WakeLoop)
+{
+	// NOTE(Felix): WakeLoop gets woken up whenever jobs got completed, may be 0
+	pthread_mutex_init(&System->Mutex, 0);
+	pthread_cond_init(&System->JobAvailable, 0);
+	System->WakeLoop = WakeLoop;
+	WorkerCount = CLAMP(1, WorkerCount, JOB_MAX_WORKERS);
+	for (u32 WorkerIndex = 0; WorkerIndex < WorkerCount; ++WorkerIndex)
+	{
+		if (pthread_create(&System->Workers[System->WorkerCount], 0, &JobWorkerThread, System) == 0)
+		{
+			++System->WorkerCount;
+		}
+	}
+}
+
+internal void
+JobSubmit(job_system *System, job *Job)
+{
+	// NOTE(Felix): The job must not be in the system already (submitted but not completed)
+	Job->IsCancelled = 0;
+	Job->WasRun = 0;
+	Job->Next = 0;
+	++System->SubmittedCount;
+
+	pthread_mutex_lock(&System->Mutex);
+	if (System->QueueLast)
+	{
+		System->QueueLast->Next = Job;
+	}
+	else
+	{
+		System->QueueFirst = Job;
+	}
+	System->QueueLast = Job;
+	pthread_cond_signal(&System->JobAvailable);
+	pthread_mutex_unlock(&System->Mutex);
+}
+
+internal u32
+JobSystemDrain(job_system *System)
+{
+	// NOTE(Felix): Completes every job that finished so far, returns how many
+	job *Newest = __atomic_exchange_n(&System->Completed, 0, __ATOMIC_ACQUIRE);
+	job *Oldest = 0;
+	while (Newest)
+	{
+		job *Next = Newest->Next;
+		Newest->Next = Oldest;
+		Oldest = Newest;
+		Newest = Next;
+	}
+
+	u32 Count = 0;
+	while (Oldest)
+	{
+		// NOTE(Felix): Complete may reuse (or free) the job, Next has to be read first
+		job *Job = Oldest;
+		Oldest = Job->Next;
+		Job->Next = 0;
+		if (Job->Complete)
+		{
+			Job->Complete(Job);
+		}
+		++Count;
+	}
+	System->CompletedCount += Count;
+	return (Count);
+}
+
+#define JOB_STRESS_SLOT_COUNT 1024
+#define JOB_STRESS_JOB_COUNT (1u << 20)
+#define JOB_STRESS_MAX_WORK 4096
+#define JOB_STRESS_STALL_NANOSECONDS (10ull*1000*1000*1000)
+#define JOB_STRESS_POLL_NANOSECONDS (100*1000)
+
+typedef struct job_stress job_stress;
+
+typedef struct
+{
+	job Job;
+	job_stress *Stress;
+	b32 IsInFlight; // Submitted and not completed yet, only touched on the submitting thread
+	u32 Work;
+
+	// NOTE(Felix): Accessed atomically, workers count every run and catch overlapping ones
+	u32 RunCount;
+	u32 IsRunning;
+	u32 RunCountSeen;
+} job_stress_slot;
+
+struct job_stress
+{
+	job_system *Jobs;
+	u64 Random;
+	job_stress_slot Slots[JOB_STRESS_SLOT_COUNT];
+
+	u64 SubmittedCount;
+	u64 CompletedCount;
+	u64 RunCount;
+	u64 SkippedCount;
+	u64 StoppedCount;
+	u64 ErrorCount; // Accessed atomically
+};
+
+internal u32
+JobStressRandom(job_stress *Stress)
+{
+	// NOTE(Felix): xorshift64, only ever called on the submitting thread
+	Stress->Random ^= Stress->Random << 13;
+	Stress->Random ^= Stress->Random >> 7;
+	Stress->Random ^= Stress->Random << 17;
+	return ((u32)(Stress->Random >> 32));
+}
+
+internal void
+JobStressSlotRun(job *Job)
+{
+	job_stress_slot *Slot = Job->Data;
+	if (__atomic_exchange_n(&Slot->IsRunning, 1, __ATOMIC_ACQUIRE))
+	{
+		__atomic_add_fetch(&Slot->Stress->ErrorCount, 1, __ATOMIC_RELAXED);
+	}
+	__atomic_add_fetch(&Slot->RunCount, 1, __ATOMIC_RELAXED);
+
+	// NOTE(Felix): Busy work that stops early once cancelled, like a real job would
+	volatile u32 Sink = 0;
+	for (u32 Step = 0; Step < Slot->Work; ++Step)
+	{
+		if (0 == (Step % 64) && JobIsCancelled(Job))
+		{
+			break;
+		}
+		Sink += Step;
+	}
+	__atomic_store_n(&Slot->IsRunning, 0, __ATOMIC_RELEASE);
+}
+
+internal void
+JobStressSlotSubmit(job_stress *Stress, job_stress_slot *Slot)
+{
+	Slot->IsInFlight = 1;
+	Slot->Work = JobStressRandom(Stress) % JOB_STRESS_MAX_WORK;
+	++Stress->SubmittedCount;
+	JobSubmit(Stress->Jobs, &Slot->Job);
+}
+
+internal void
+JobStressSlotComplete(job *Job)
+{
+	// NOTE(Felix): Every submission has to be completed exactly once, and it has to have run
+	// exactly once if WasRun says so and not at all otherwise
+	job_stress_slot *Slot = Job->Data;
+	job_stress *Stress = Slot->Stress;
+	u32 RunCount = __atomic_load_n(&Slot->RunCount, __ATOMIC_RELAXED);
+	u32 NewRuns = RunCount - Slot->RunCountSeen;
+	Slot->RunCountSeen = RunCount;
+	if (0 == Slot->IsInFlight || NewRuns != (Job->WasRun ? 1u : 0u))
+	{
+		__atomic_add_fetch(&Stress->ErrorCount, 1, __ATOMIC_RELAXED);
+	}
+	Slot->IsInFlight = 0;
+
+	++Stress->CompletedCount;
+	if (Job->WasRun)
+	{
+		++Stress->RunCount;
+		Stress->StoppedCount += (JobIsCancelled(Job) ? 1 : 0);
+	}
+	else
+	{
+		++Stress->SkippedCount;
+	}
+
+	// NOTE(Felix): Completed jobs may be reused right away, some are resubmitted from here
+	if (Stress->SubmittedCount < JOB_STRESS_JOB_COUNT && 0 == (JobStressRandom(Stress) % 4))
+	{
+		JobStressSlotSubmit(Stress, Slot);
+	}
+}
+
+internal b32
+JobStressRun(void)
+{
+	// NOTE(Felix): "--job-stress": floods a job system of its own with jobs, cancels random
+	// ones (queued, running or already finished) and reuses the job structs once they're
+	// completed. Returns whether every job was completed exactly once.
+	// There's no event loop to wake, the drain just polls
+	job_system Jobs = { 0 };
+	JobSystemStart(&Jobs, JOB_MAX_WORKERS, 0);
+
+	job_stress *Stress = mmap(0, sizeof(job_stress), PROT_READ|PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (Stress == MAP_FAILED)
+	{
+		fprintf(stderr, "Couldn't allocate the job stress test\n");
+		return (0);
+	}
+	Stress->Jobs = &Jobs;
+	Stress->Random = ConsoleTimeGetNanoseconds() | 1;
+	for (u32 SlotIndex = 0; SlotIndex < JOB_STRESS_SLOT_COUNT; ++SlotIndex)
+	{
+		job_stress_slot *Slot = &Stress->Slots[SlotIndex];
+		Slot->Stress = Stress;
+		Slot->Job.Run = &JobStressSlotRun;
+		Slot->Job.Complete = &JobStressSlotComplete;
+		Slot->Job.Data = Slot;
+	}
+
+	u64 StartTime = ConsoleTimeGetNanoseconds();
+	u64 LastProgressTime = StartTime;
+	b32 HasStalled = 0;
+	while (Stress->SubmittedCount < JOB_STRESS_JOB_COUNT || Stress->CompletedCount < Stress->SubmittedCount)
+	{
+		for (u32 Attempt = 0; Attempt < 64 && Stress->SubmittedCount < JOB_STRESS_JOB_COUNT; ++Attempt)
+		{
+			job_stress_slot *Slot = &Stress->Slots[JobStressRandom(Stress) % JOB_STRESS_SLOT_COUNT];
+			if (0 == Slot->IsInFlight)
+			{
+				JobStressSlotSubmit(Stress, Slot);
+			}
+		}
+		for (u32 Attempt = 0; Attempt < 32; ++Attempt)
+		{
+			job_stress_slot *Slot = &Stress->Slots[JobStressRandom(Stress) % JOB_STRESS_SLOT_COUNT];
+			if (Slot->IsInFlight)
+			{
+				JobCancel(&Slot->Job);
+			}
+		}
+
+		u64 Now = ConsoleTimeGetNanoseconds();
+		if (JobSystemDrain(&Jobs))
+		{
+			LastProgressTime = Now;
+		}
+		else if (Now - LastProgressTime > JOB_STRESS_STALL_NANOSECONDS)
+		{
+			HasStalled = 1;
+			break;
+		}
+		else if (Stress->SubmittedCount == JOB_STRESS_JOB_COUNT)
+		{
+			struct timespec Pause = { 0, JOB_STRESS_POLL_NANOSECONDS };
+			nanosleep(&Pause, 0);
+		}
+	}
+	f64 Seconds = (f64)(ConsoleTimeGetNanoseconds() - StartTime) / 1e9;
+
+	u64 ErrorCount = __atomic_load_n(&Stress->ErrorCount, __ATOMIC_RELAXED);
+	printf("%" PFu64 " jobs on %" PFu32 " workers in %.2f s: %" PFu64 " completed, %" PFu64 " run (%" PFu64 
+	       " stopped early), %" PFu64 " skipped\n", Stress->SubmittedCount, Jobs.WorkerCount, Seconds,
+	       Stress->CompletedCount, Stress->RunCount, Stress->StoppedCount, Stress->SkippedCount);
+	if (HasStalled)
+	{
+		printf("%" PFu64 " jobs were never completed\n", Stress->SubmittedCount - Stress->CompletedCount);
+	}
+	if (ErrorCount)
+	{
+		printf("%" PFu64 " jobs weren't completed or run exactly once\n", ErrorCount);
+	}
+	b32 IsOk = (0 == HasStalled && 0 == ErrorCount && Stress->CompletedCount == Stress->SubmittedCount);
+	printf("%s\n", IsOk ? "OK" : "FAILED");
+
+	// NOTE(Felix): The workers can't be stopped, Stress stays around for them
+	return (IsOk);
+}
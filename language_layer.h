@@ -222,6 +222,18 @@ StringCopy(char *Destination, char *ToCopy)
 	*Destination = 0;
 }
 
+internal void
+StringCopyBounded(char *Destination, char *ToCopy, u32 DestinationSize)
+{
+	// NOTE(Felix): Cuts ToCopy off if it doesn't fit, Destination is always terminated
+	u32 Index = 0;
+	for (; Index+1 < DestinationSize && ToCopy[Index] != 0; ++Index)
+	{
+		Destination[Index] = ToCopy[Index];
+	}
+	Destination[Index] = 0;
+}
+
 internal void
 StringAppend(char *Destination, char *ToAppend)
 {
@@ -10,9 +10,24 @@
 #include <sys/wait.h>
 #include <poll.h>
 #include <errno.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <pwd.h>
+#include <sys/resource.h>
 
 #include "language_layer.h"
 #include "console.c"
+#include "arena.c"
+#include "string_match.c"
+#include "fuzzy_match.c"
+#include "pattern_match.c"
+#include "metadata_query.c"
+#include "stat_ring.c"
+#include "screen.c"
+#include "input.c"
+#include "event_loop.c"
+#include "job.c"
 #include "main.h"
 #include "config.h"
 
@@ -26,13 +41,21 @@
 // TODO(Felix): A few features we may want to implement:
 // - Help page that displays all hotkeys
 // - I think we should rename "filter" to "search", but meh
-// - Some kind of mechanism that doesn't make our program crash if we don't have enough memory
-//     to hold all directory entries at once
 
 // TODO(Felix): Bugs:
 //  - Sometimes our selection is not within the view
 
-global_variable b32 GLOBALUpdateConsoleDimensions = 0;
+global_variable event_loop GLOBALEventLoop;
+global_variable job_system GLOBALJobs;
+global_variable screen GLOBALScreen;
+global_variable input_buffer GLOBALInput;
+global_variable stat_batch GLOBALStatBatches[STAT_BATCH_COUNT];
+global_variable owner_name GLOBALOwnerNames[OWNER_NAME_CACHE_SIZE];
+global_variable u32 GLOBALListingGeneration;
+global_variable u32 GLOBALListingMaxEntries; // See DirectoryListingLimitsSet
+global_variable directory_cache GLOBALDirectoryCache;
+global_variable directory_prefetch GLOBALDirectoryPrefetch;
+global_variable b32 GLOBALStatRingDisabled; // Once io_uring failed, or with "--no-io-uring"
 
 internal char *
 GetProgramNameFromFullPath(char *FullPath)
@@ -89,11 +112,14 @@ GetProgramToUseConfig(char *FileName)
 }
 
 internal b32
-FileIsExecutable(char *FileName)
+FileIsExecutable(i32 DirectoryFileDescriptor, char *FileName)
 {
+	// NOTE(Felix): Always asks the file system, whatever the listing fetched may be stale by 
+	// now. Follows symlinks since execl does too. Without a directory descriptor the name
+	// is relative to the working directory, which is the listed directory.
 	struct stat FileData = { 0 };
-	stat(FileName, &FileData);
-	return (FileData.st_mode & S_IXUSR);
+	i32 At = (DirectoryFileDescriptor >= 0) ? DirectoryFileDescriptor : AT_FDCWD;
+	return (0 == fstatat(At, FileName, &FileData, 0) && S_ISREG(FileData.st_mode) && (FileData.st_mode & S_IXUSR));
 }
 
 internal void
@@ -148,14 +174,14 @@ LeaveDirectory(char *PathBuffer)
 }
 
 internal color
-LineColorGetFromEntry(internal_directory_entry Entry, b32 EntrySelected)
+LineColorGetFromEntry(entry_type EntryType, b32 EntrySelected)
 {
 	color Result = { 0 };
 
 	if (EntrySelected)
 	{
 		ansi_color_code BackgroundColor = 0;
-		switch (Entry.Type)
+		switch (EntryType)
 		{
 			case ENTRY_TYPE_FILE: {
 				BackgroundColor = COLOR_SELECTED_BACKGROUND_FILE;
@@ -176,7 +202,7 @@ LineColorGetFromEntry(internal_directory_entry Entry, b32 EntrySelected)
 	else
 	{
 		ansi_color_code ForegroundColor = 0;
-		switch (Entry.Type)
+		switch (EntryType)
 		{
 			case ENTRY_TYPE_FILE: {
 				ForegroundColor = COLOR_UNSELECTED_FOREGROUND_FILE;
@@ -213,6 +239,12 @@ ColorResetToDefault()
 	ColorSet(Default);
 }
 
+internal void
+ScreenColorSetFromColor(screen *Screen, color Color)
+{
+	ScreenColorSet(Screen, (u8)Color.Foreground, (u8)Color.Background);
+}
+
 internal void
 DirectoryEntryPrint(struct dirent *DirectoryEntry)
 {
@@ -223,64 +255,409 @@ DirectoryEntryPrint(struct dirent *DirectoryEntry)
 	printf("d_name:   %s\n\n", DirectoryEntry->d_name);
 }
 
-internal b32
-InternalEntryCompareName(internal_directory_entry *A, internal_directory_entry *B)
+internal char *
+DirectoryListingName(directory_listing *Listing, u32 EntryIndex)
+{
+	return (Listing->Names + Listing->NameOffset[EntryIndex]);
+}
+
+internal u32
+SortKeyFromName(char *Name)
+{
+	// NOTE(Felix): Packs the first four (uppercased) characters big endian into a u32, so
+	// that comparing keys gives the same order as InternalEntryCompareName on those characters.
+	// Flipping the top bit keeps the signed char ordering the name compare uses.
+	// Anything past the zero terminator is left as zero.
+	u32 Key = 0;
+	b32 ReachedEnd = 0;
+	for (u32 Index = 0; Index < 4; ++Index)
+	{
+		u8 Byte = 0;
+		if (0 == ReachedEnd)
+		{
+			Byte = (u8)((u8)CharToUpperIfIsLetter(Name[Index]) ^ 0x80);
+			ReachedEnd = (Name[Index] == 0);
+		}
+		Key = (Key << 8) | Byte;
+	}
+	return (Key);
+}
+
+internal i32
+InternalEntryCompareName(directory_listing *Listing, u32 A, u32 B)
 {
 	// TODO(Felix): This sorting does only work for ascii, so rip my asian tab files
 	// Also we're not sorting numbers only files correctly, reee 
-	i32 Balance = 0;
+	u32 KeyA = Listing->SortKey[A];
+	u32 KeyB = Listing->SortKey[B];
+	if (KeyA != KeyB)
+	{
+		return ((KeyA > KeyB) ? 1 : -1);
+	}
+
+	char *NameA = DirectoryListingName(Listing, A);
+	char *NameB = DirectoryListingName(Listing, B);
 	i32 Index = 0;
-	while (Balance == 0 &&
-	       A->Name[Index] != 0)
+	while (NameA[Index] != 0 &&
+	       CharToUpperIfIsLetter(NameA[Index]) == CharToUpperIfIsLetter(NameB[Index]))
 	{
-		char CharacterA = CharToUpperIfIsLetter(A->Name[Index]);
-		char CharacterB = CharToUpperIfIsLetter(B->Name[Index]);
-		Balance = CharacterA - CharacterB;
 		++Index;
 	}
-	return (Balance > 0);
+	i32 Balance = CharToUpperIfIsLetter(NameA[Index]) - CharToUpperIfIsLetter(NameB[Index]);
+	return (Balance);
+}
+
+internal i32
+InternalEntryCompareType(directory_listing *Listing, u32 A, u32 B)
+{
+	i32 Balance = (i32)Listing->Type[A] - (i32)Listing->Type[B];
+	return (Balance);
 }
 
 internal i32
-InternalEntryCompareType(internal_directory_entry *A, internal_directory_entry *B)
+InternalEntryCompare(directory_listing *Listing, u32 A, u32 B)
 {
-	i32 Balance = (i32)(A->Type - B->Type);
-	return (Balance > 0);
+	// NOTE(Felix): Directories first, then by name
+	i32 Balance = InternalEntryCompareType(Listing, A, B);
+	if (Balance == 0)
+	{
+		Balance = InternalEntryCompareName(Listing, A, B);
+	}
+	return (Balance);
+}
+
+internal void
+IndexListInsertionSort(u32 *Indices, u32 Count, directory_listing *Listing)
+{
+	for (u32 SortedCount = 1; SortedCount < Count; ++SortedCount)
+	{
+		u32 ToInsert = Indices[SortedCount];
+		u32 Slot = SortedCount;
+		for (; 
+		     Slot > 0 && InternalEntryCompare(Listing, Indices[Slot-1], ToInsert) > 0;
+		     --Slot)
+		{
+			Indices[Slot] = Indices[Slot-1];
+		}
+		Indices[Slot] = ToInsert;
+	}
 }
 
 internal void
-InternalEntryListSort(internal_directory_entry *EntryList, i32 EntryCount,
-                      b32 (*CompareFunction)(internal_directory_entry *A, internal_directory_entry *B))
+IndexListMerge(u32 *Destination, u32 *Left, u32 LeftCount, u32 *Right, u32 RightCount,
+               directory_listing *Listing)
+{
+	// NOTE(Felix): Ties take from the left so the merge stays stable
+	u32 LeftIndex = 0;
+	u32 RightIndex = 0;
+	u32 DestinationIndex = 0;
+	while (LeftIndex < LeftCount && RightIndex < RightCount)
+	{
+		if (InternalEntryCompare(Listing, Right[RightIndex], Left[LeftIndex]) < 0)
+		{
+			Destination[DestinationIndex++] = Right[RightIndex++];
+		}
+		else
+		{
+			Destination[DestinationIndex++] = Left[LeftIndex++];
+		}
+	}
+	while (LeftIndex < LeftCount)   { Destination[DestinationIndex++] = Left[LeftIndex++]; }
+	while (RightIndex < RightCount) { Destination[DestinationIndex++] = Right[RightIndex++]; }
+}
+
+internal u32 *
+IndexListSort(u32 *Indices, u32 *Scratch, u32 Count, directory_listing *Listing)
+{
+	// NOTE(Felix): Bottom up merge sort on indices, so we only ever move 4 bytes around
+	// instead of whole entries. Small runs are insertion sorted first.
+	// Returns whichever of the two buffers ended up holding the result.
+	enum { INSERTION_SORT_RUN_LENGTH = 16 };
+	for (u32 RunStart = 0; RunStart < Count; RunStart += INSERTION_SORT_RUN_LENGTH)
+	{
+		IndexListInsertionSort(Indices+RunStart, MIN(INSERTION_SORT_RUN_LENGTH, Count-RunStart), Listing);
+	}
+
+	u32 *Source = Indices;
+	u32 *Destination = Scratch;
+	for (u32 RunLength = INSERTION_SORT_RUN_LENGTH; RunLength < Count; RunLength *= 2)
+	{
+		for (u32 RunStart = 0; RunStart < Count; RunStart += 2*RunLength)
+		{
+			u32 LeftCount = MIN(RunLength, Count-RunStart);
+			u32 RightCount = MIN(RunLength, Count-RunStart-LeftCount);
+			IndexListMerge(Destination+RunStart, 
+			               Source+RunStart, LeftCount, 
+			               Source+RunStart+LeftCount, RightCount,
+			               Listing);
+		}
+		u32 *Temp = Source;
+		Source = Destination;
+		Destination = Temp;
+	}
+	return (Source);
+}
+
+// NOTE(Felix): Parallel sort
+// Below the threshold spawning threads costs more than it saves. Above it the index 
+// list is split into one chunk per core, every chunk gets sorted on its own thread and 
+// then pairs of runs get merged until one run is left. Each merge is cut into 
+// independent pieces (by finding where an output position splits the two inputs), so 
+// all cores stay busy in the last rounds too. Since every step is stable the result is 
+// exactly what IndexListSort produces.
+#define PARALLEL_SORT_THRESHOLD (1 << 16)
+#define PARALLEL_SORT_MAX_THREADS 64
+
+typedef struct
+{
+	directory_listing *Listing;
+	u32 *Indices;
+	u32 *Scratch;
+	u32 Count;
+} sort_chunk_work;
+
+typedef struct
+{
+	directory_listing *Listing;
+	u32 *Destination;
+	u32 *Left;
+	u32 LeftCount;
+	u32 *Right;
+	u32 RightCount;
+} sort_merge_work;
+
+internal void *
+SortChunkThread(void *Parameter)
+{
+	sort_chunk_work *Work = Parameter;
+	u32 *Sorted = IndexListSort(Work->Indices, Work->Scratch, Work->Count, Work->Listing);
+	if (Sorted != Work->Indices)
+	{
+		MemoryCopy(Work->Indices, Sorted, sizeof(u32)*Work->Count);
+	}
+	return (0);
+}
+
+internal void *
+SortMergeThread(void *Parameter)
+{
+	sort_merge_work *Work = Parameter;
+	IndexListMerge(Work->Destination, Work->Left, Work->LeftCount, Work->Right, Work->RightCount, Work->Listing);
+	return (0);
+}
+
+internal u32
+IndexListMergeSplit(u32 OutputIndex, u32 *Left, u32 LeftCount, u32 *Right, u32 RightCount,
+                    directory_listing *Listing)
+{
+	// NOTE(Felix): Returns how many elements of Left are within the first OutputIndex
+	// elements of the (stable) merge of Left and Right
+	u32 Low = (OutputIndex > RightCount) ? OutputIndex - RightCount : 0;
+	u32 High = MIN(OutputIndex, LeftCount);
+	while (Low < High)
+	{
+		u32 Middle = Low + (High - Low) / 2;
+		u32 RightIndex = OutputIndex - Middle;
+		if (InternalEntryCompare(Listing, Right[RightIndex-1], Left[Middle]) >= 0)
+		{
+			Low = Middle + 1;
+		}
+		else
+		{
+			High = Middle;
+		}
+	}
+	return (Low);
+}
+
+internal u32
+SortThreadCountGet(u32 Count)
+{
+	u32 ThreadCount = 1;
+	if (Count >= PARALLEL_SORT_THRESHOLD)
+	{
+		long ProcessorCount = sysconf(_SC_NPROCESSORS_ONLN);
+		ThreadCount = (u32)CLAMP(1, ProcessorCount, PARALLEL_SORT_MAX_THREADS);
+	}
+	return (ThreadCount);
+}
+
+internal u32 *
+IndexListSortParallel(u32 *Indices, u32 *Scratch, u32 Count, u32 ThreadCount, 
+                      directory_listing *Listing)
 {
-	// TODO(Felix): Selection sort, replace with quicksort
-	// (maybe generalize for include)
+	pthread_t Threads[PARALLEL_SORT_MAX_THREADS];
+	b32 IsStarted[PARALLEL_SORT_MAX_THREADS];
+	u32 RunStart[PARALLEL_SORT_MAX_THREADS+1];
 
-	for (i32 SortedIndex = 0; SortedIndex < EntryCount; ++SortedIndex)
+	// NOTE(Felix): Sort one chunk per thread
 	{
-		i32 MinimumIndex = SortedIndex;
-		for (i32 UnsortedIndex = SortedIndex+1; UnsortedIndex < EntryCount; ++UnsortedIndex)
+		sort_chunk_work ChunkWork[PARALLEL_SORT_MAX_THREADS];
+		for (u32 ThreadIndex = 0; ThreadIndex <= ThreadCount; ++ThreadIndex)
+		{
+			RunStart[ThreadIndex] = (u32)(((u64)Count * ThreadIndex) / ThreadCount);
+		}
+		for (u32 ThreadIndex = 0; ThreadIndex < ThreadCount; ++ThreadIndex)
+		{
+			sort_chunk_work *Work = &ChunkWork[ThreadIndex];
+			Work->Listing = Listing;
+			Work->Indices = Indices + RunStart[ThreadIndex];
+			Work->Scratch = Scratch + RunStart[ThreadIndex];
+			Work->Count = RunStart[ThreadIndex+1] - RunStart[ThreadIndex];
+			// NOTE(Felix): If we can't get a thread, the chunk is just sorted right here
+			IsStarted[ThreadIndex] = (pthread_create(&Threads[ThreadIndex], 0, &SortChunkThread, Work) == 0);
+			if (0 == IsStarted[ThreadIndex])
+			{
+				SortChunkThread(Work);
+			}
+		}
+		for (u32 ThreadIndex = 0; ThreadIndex < ThreadCount; ++ThreadIndex)
+		{
+			if (IsStarted[ThreadIndex])
+			{
+				pthread_join(Threads[ThreadIndex], 0);
+			}
+		}
+	}
+
+	// NOTE(Felix): Merge neighbouring runs until only one is left
+	u32 *Source = Indices;
+	u32 *Destination = Scratch;
+	u32 RunCount = ThreadCount;
+	while (RunCount > 1)
+	{
+		sort_merge_work MergeWork[PARALLEL_SORT_MAX_THREADS];
+		u32 MergeWorkCount = 0;
+		u32 PairCount = RunCount / 2;
+		u32 PiecesPerPair = MAX(1, ThreadCount / PairCount);
+
+		for (u32 PairIndex = 0; PairIndex < PairCount; ++PairIndex)
+		{
+			u32 Start = RunStart[2*PairIndex];
+			u32 Middle = RunStart[2*PairIndex+1];
+			u32 End = RunStart[2*PairIndex+2];
+			u32 *Left = Source + Start;
+			u32 *Right = Source + Middle;
+			u32 LeftCount = Middle - Start;
+			u32 RightCount = End - Middle;
+
+			u32 PreviousLeftSplit = 0;
+			u32 PreviousOutputSplit = 0;
+			for (u32 PieceIndex = 1; PieceIndex <= PiecesPerPair; ++PieceIndex)
+			{
+				u32 OutputSplit = (u32)(((u64)(LeftCount+RightCount) * PieceIndex) / PiecesPerPair);
+				u32 LeftSplit = IndexListMergeSplit(OutputSplit, Left, LeftCount, Right, RightCount, Listing);
+
+				sort_merge_work *Work = &MergeWork[MergeWorkCount++];
+				Work->Listing = Listing;
+				Work->Destination = Destination + Start + PreviousOutputSplit;
+				Work->Left = Left + PreviousLeftSplit;
+				Work->LeftCount = LeftSplit - PreviousLeftSplit;
+				Work->Right = Right + (PreviousOutputSplit - PreviousLeftSplit);
+				Work->RightCount = (OutputSplit - LeftSplit) - (PreviousOutputSplit - PreviousLeftSplit);
+
+				PreviousLeftSplit = LeftSplit;
+				PreviousOutputSplit = OutputSplit;
+			}
+		}
+
+		// NOTE(Felix): An odd run out just gets carried over into the next round
+		if (RunCount % 2)
+		{
+			u32 Start = RunStart[RunCount-1];
+			MemoryCopy(Destination+Start, Source+Start, sizeof(u32)*(RunStart[RunCount] - Start));
+		}
+
+		for (u32 WorkIndex = 0; WorkIndex < MergeWorkCount; ++WorkIndex)
+		{
+			IsStarted[WorkIndex] = (pthread_create(&Threads[WorkIndex], 0, &SortMergeThread, &MergeWork[WorkIndex]) == 0);
+			if (0 == IsStarted[WorkIndex])
+			{
+				SortMergeThread(&MergeWork[WorkIndex]);
+			}
+		}
+		for (u32 WorkIndex = 0; WorkIndex < MergeWorkCount; ++WorkIndex)
 		{
-			if (CompareFunction(EntryList+MinimumIndex, EntryList+UnsortedIndex))
+			if (IsStarted[WorkIndex])
 			{
-				MinimumIndex = UnsortedIndex;
+				pthread_join(Threads[WorkIndex], 0);
 			}
 		}
 
-		// NOTE(Felix): Swap minimum of unsorted sublist to start
-		if (MinimumIndex != SortedIndex)
+		u32 NewRunCount = 0;
+		for (u32 RunIndex = 0; RunIndex < RunCount; RunIndex += 2)
 		{
-			internal_directory_entry Temp = EntryList[SortedIndex];
-			EntryList[SortedIndex] = EntryList[MinimumIndex];
-			EntryList[MinimumIndex] = Temp;
+			RunStart[NewRunCount++] = RunStart[RunIndex];
 		}
+		RunStart[NewRunCount] = Count;
+		RunCount = NewRunCount;
+
+		u32 *Temp = Source;
+		Source = Destination;
+		Destination = Temp;
 	}
+
+	return (Source);
+}
+
+internal u32
+DirectoryListingGenerationNext(void)
+{
+	// NOTE(Felix): Prefetched listings are sorted on a worker, see directory_prefetch
+	return (__atomic_add_fetch(&GLOBALListingGeneration, 1, __ATOMIC_RELAXED));
+}
+
+internal void
+DirectoryListingApplyOrder(directory_listing *Listing, u32 *Order, void *Scratch)
+{
+	// NOTE(Felix): Slot i has to receive the entry at Order[i]. Every per entry array is 
+	// gathered into Scratch and copied back, the names themselves never move.
+	// Scratch has to hold 8 bytes per entry, every array goes through it with its own type
+	u32 Count = Listing->Count;
+	u32 *Scratch32 = Scratch;
+	u64 *Scratch64 = Scratch;
+	i64 *ScratchSigned64 = Scratch;
+	u8 *Scratch8 = Scratch;
+
+	for (u32 Index = 0; Index < Count; ++Index) { Scratch32[Index] = Listing->NameOffset[Order[Index]]; }
+	MemoryCopy(Listing->NameOffset, Scratch32, sizeof(u32)*Count);
+
+	for (u32 Index = 0; Index < Count; ++Index) { Scratch32[Index] = Listing->SortKey[Order[Index]]; }
+	MemoryCopy(Listing->SortKey, Scratch32, sizeof(u32)*Count);
+
+	for (u32 Index = 0; Index < Count; ++Index) { Scratch32[Index] = Listing->CharMask[Order[Index]]; }
+	MemoryCopy(Listing->CharMask, Scratch32, sizeof(u32)*Count);
+
+	for (u32 Index = 0; Index < Count; ++Index) { Scratch32[Index] = Listing->Mode[Order[Index]]; }
+	MemoryCopy(Listing->Mode, Scratch32, sizeof(u32)*Count);
+
+	for (u32 Index = 0; Index < Count; ++Index) { Scratch32[Index] = Listing->Owner[Order[Index]]; }
+	MemoryCopy(Listing->Owner, Scratch32, sizeof(u32)*Count);
+
+	for (u32 Index = 0; Index < Count; ++Index) { Scratch64[Index] = Listing->Size[Order[Index]]; }
+	MemoryCopy(Listing->Size, Scratch64, sizeof(u64)*Count);
+
+	for (u32 Index = 0; Index < Count; ++Index) { ScratchSigned64[Index] = Listing->ModifiedTime[Order[Index]]; }
+	MemoryCopy(Listing->ModifiedTime, ScratchSigned64, sizeof(i64)*Count);
+
+	for (u32 Index = 0; Index < Count; ++Index) { Scratch8[Index] = Listing->NameLength[Order[Index]]; }
+	MemoryCopy(Listing->NameLength, Scratch8, Count);
+
+	for (u32 Index = 0; Index < Count; ++Index) { Scratch8[Index] = Listing->Type[Order[Index]]; }
+	MemoryCopy(Listing->Type, Scratch8, Count);
+
+	// NOTE(Felix): Batches in flight refer to the old indices, their results get dropped and
+	// the entries requested again
+	for (u32 Index = 0; Index < Count; ++Index) { Scratch8[Index] = Listing->Flags[Order[Index]] & (u8)~ENTRY_FLAG_STAT_PENDING; }
+	MemoryCopy(Listing->Flags, Scratch8, Count);
+	Listing->Generation = DirectoryListingGenerationNext();
 }
 
 internal void
-InternalEntryPrint(internal_directory_entry Entry)
+InternalEntryPrint(directory_listing *Listing, u32 EntryIndex)
 {
 	char *TypeString = 0;
-	switch (Entry.Type)
+	switch (Listing->Type[EntryIndex])
 	{
 		case ENTRY_TYPE_UNKNOWN: {
 			TypeString = "Unknown";
@@ -295,133 +672,2289 @@ InternalEntryPrint(internal_directory_entry Entry)
 		} break;
 	}
 
-	printf("Name: %s\n",   Entry.Name);
+	printf("Name: %s\n",   DirectoryListingName(Listing, EntryIndex));
 	printf("Type: %s\n\n", TypeString);
 }
 
-internal internal_directory_entry
-CreateInternalEntryFromDirent(struct dirent *Entry)
+// NOTE(Felix): Upper bounds for the address space a single listing reserves, an address
+// space limit (ulimit -v) lowers them, see DirectoryListingLimitsSet.
+// Names get DIRECTORY_LISTING_NAMES_SIZE_PER_ENTRY bytes per entry on average. Name offsets
+// are u32, so the name buffer can't be bigger than 4GiB anyway
+#define DIRECTORY_LISTING_MAX_ENTRIES (1u << 24)
+#define DIRECTORY_LISTING_NAMES_SIZE_PER_ENTRY 64
+#define DIRECTORY_LISTING_MAX_NAMES_SIZE GIBIBYTES(4)
+#define DIRECTORY_LISTING_MIN_CAPACITY 4096
+
+// NOTE(Felix): Listings that may be around at once: the current one, the cached ones and a prefetch
+#define DIRECTORY_LISTING_MAX_ALIVE (DIRECTORY_CACHE_MAX_LISTINGS + 2)
+
+// NOTE(Felix): Every filter level is at most as big as the listing, in practice they shrink
+// quickly. Room for 16 levels as big as the listing (or fewer in fuzzy mode, the scores and
+// the ranking go onto the arena as well), see directory_view for when that isn't enough.
+// The slack is for the buckets of the ranking
+#define DIRECTORY_VIEW_LEVELS_SIZE_PER_ENTRY 64
+#define DIRECTORY_VIEW_LEVELS_SLACK MEBIBYTES(1)
+
+// NOTE(Felix): After a directory is loaded, arenas are trimmed back to twice of what is used
+// (but never below this), so leaving a huge directory for a small one gives the memory back
+#define DIRECTORY_LISTING_KEEP_COMMITTED KIBIBYTES(256)
+
+internal u64
+DirectoryListingEntryReserveSize(void)
+{
+	// NOTE(Felix): Address space a listing reserves per entry it can hold
+	directory_listing *Listing = 0;
+	return (sizeof(Listing->NameOffset[0]) + sizeof(Listing->NameLength[0]) + sizeof(Listing->Type[0]) +
+	        sizeof(Listing->Flags[0]) + sizeof(Listing->SortKey[0]) + sizeof(Listing->CharMask[0]) +
+	        sizeof(Listing->Size[0]) + sizeof(Listing->ModifiedTime[0]) + sizeof(Listing->Mode[0]) +
+	        sizeof(Listing->Owner[0]) + DIRECTORY_LISTING_NAMES_SIZE_PER_ENTRY + DIRECTORY_VIEW_LEVELS_SIZE_PER_ENTRY);
+}
+
+internal void
+DirectoryListingLimitsSet(void)
 {
-	internal_directory_entry Result = { 0 };
-	Result.NameLength = (i32)StringLength(Entry->d_name);
-	MemoryCopy(&Result.Name, Entry->d_name, (u32)Result.NameLength);
-	Result.NameLength = (i32)StringLength(Result.Name);
-	switch (Entry->d_type)
+	// NOTE(Felix): Under an address space limit every listing that may be around at once has
+	// to fit into half of it, the rest is left to everything else. Call before any listing
+	// is allocated
+	u64 MaxEntries = DIRECTORY_LISTING_MAX_ENTRIES;
+	struct rlimit Limit;
+	if (0 == getrlimit(RLIMIT_AS, &Limit) && Limit.rlim_cur != RLIM_INFINITY)
 	{
-		case DT_DIR: {
-			Result.Type = ENTRY_TYPE_DIRECTORY;
-		} break;
+		u64 ListingSize = (u64)Limit.rlim_cur / (2*DIRECTORY_LISTING_MAX_ALIVE);
+		MaxEntries = CLAMP(DIRECTORY_LISTING_MIN_CAPACITY, ListingSize / DirectoryListingEntryReserveSize(), MaxEntries);
+	}
+	GLOBALListingMaxEntries = (u32)MaxEntries;
+}
 
-		case DT_REG: {
-			Result.Type = ENTRY_TYPE_FILE;
-		} break;
+internal void
+DirectoryListingArenasRelease(directory_listing *Listing)
+{
+	ArenaRelease(&Listing->NamesArena);
+	ArenaRelease(&Listing->NameOffsetArena);
+	ArenaRelease(&Listing->NameLengthArena);
+	ArenaRelease(&Listing->TypeArena);
+	ArenaRelease(&Listing->FlagsArena);
+	ArenaRelease(&Listing->SortKeyArena);
+	ArenaRelease(&Listing->CharMaskArena);
+	ArenaRelease(&Listing->SizeArena);
+	ArenaRelease(&Listing->ModifiedTimeArena);
+	ArenaRelease(&Listing->ModeArena);
+	ArenaRelease(&Listing->OwnerArena);
+	ArenaRelease(&Listing->View.LevelArena);
+}
 
-		default: {
-			Assert(0);
-		} break;
+internal b32
+DirectoryListingAllocate(directory_listing *Listing)
+{
+	// NOTE(Felix): Returns 0 if the address space couldn't be reserved. The listing is empty
+	// then and can't hold any entries, but is fine to use (and free) otherwise
+	MemoryClear(Listing, sizeof(*Listing));
+	Listing->DirectoryFileDescriptor = -1;
+	u64 MaxEntries = GLOBALListingMaxEntries;
+	b32 Reserved = 
+		ArenaReserve(&Listing->NamesArena,      MIN(MaxEntries*DIRECTORY_LISTING_NAMES_SIZE_PER_ENTRY, DIRECTORY_LISTING_MAX_NAMES_SIZE)) &&
+		ArenaReserve(&Listing->NameOffsetArena, MaxEntries*sizeof(Listing->NameOffset[0])) &&
+		ArenaReserve(&Listing->NameLengthArena, MaxEntries*sizeof(Listing->NameLength[0])) &&
+		ArenaReserve(&Listing->TypeArena,       MaxEntries*sizeof(Listing->Type[0])) &&
+		ArenaReserve(&Listing->FlagsArena,      MaxEntries*sizeof(Listing->Flags[0])) &&
+		ArenaReserve(&Listing->SortKeyArena,    MaxEntries*sizeof(Listing->SortKey[0])) &&
+		ArenaReserve(&Listing->CharMaskArena,   MaxEntries*sizeof(Listing->CharMask[0])) &&
+		ArenaReserve(&Listing->SizeArena,         MaxEntries*sizeof(Listing->Size[0])) &&
+		ArenaReserve(&Listing->ModifiedTimeArena, MaxEntries*sizeof(Listing->ModifiedTime[0])) &&
+		ArenaReserve(&Listing->ModeArena,         MaxEntries*sizeof(Listing->Mode[0])) &&
+		ArenaReserve(&Listing->OwnerArena,        MaxEntries*sizeof(Listing->Owner[0])) &&
+		ArenaReserve(&Listing->View.LevelArena,   MaxEntries*DIRECTORY_VIEW_LEVELS_SIZE_PER_ENTRY + DIRECTORY_VIEW_LEVELS_SLACK);
+	if (0 == Reserved)
+	{
+		DirectoryListingArenasRelease(Listing);
+		return (0);
 	}
-	return (Result);
+
+	Listing->Names      = (char *)Listing->NamesArena.Base;
+	Listing->NameOffset = (u32 *)Listing->NameOffsetArena.Base;
+	Listing->NameLength = Listing->NameLengthArena.Base;
+	Listing->Type       = Listing->TypeArena.Base;
+	Listing->Flags      = Listing->FlagsArena.Base;
+	Listing->SortKey    = (u32 *)Listing->SortKeyArena.Base;
+	Listing->CharMask   = (u32 *)Listing->CharMaskArena.Base;
+	Listing->Size         = (u64 *)Listing->SizeArena.Base;
+	Listing->ModifiedTime = (i64 *)Listing->ModifiedTimeArena.Base;
+	Listing->Mode         = (u32 *)Listing->ModeArena.Base;
+	Listing->Owner        = (u32 *)Listing->OwnerArena.Base;
+	return (1);
+}
+
+internal void
+DirectoryListingClear(directory_listing *Listing)
+{
+	Listing->Count = 0;
+	Listing->LoadedCount = 0;
+	Listing->IsTruncated = 0;
+	Listing->Generation = DirectoryListingGenerationNext();
+	ArenaReset(&Listing->NamesArena);
 }
 
 internal b32
-FilterKeepEntry(char *EntryName, b32 FilterHiddenEntries, 
-                char *SearchString, b32 FilterIsCaseSensitive)
+DirectoryListingGrow(directory_listing *Listing)
 {
-	b32 KeepEntry = 1;
+	u64 NewCapacity = MAX(DIRECTORY_LISTING_MIN_CAPACITY, 2*(u64)Listing->Capacity);
+	NewCapacity = MIN(NewCapacity, GLOBALListingMaxEntries);
+	if (NewCapacity <= Listing->Capacity)
+	{
+		return (0);
+	}
 
-	// NOTE(Felix): We don't want "." and ".." directory links
-	if ((EntryName[0] == '.' && EntryName[1] == 0)  ||
-	    (EntryName[0] == '.' && EntryName[1] == '.' && EntryName[2] == 0))
+	b32 Committed =
+		ArenaCommit(&Listing->NameOffsetArena, NewCapacity*sizeof(Listing->NameOffset[0])) &&
+		ArenaCommit(&Listing->NameLengthArena, NewCapacity*sizeof(Listing->NameLength[0])) &&
+		ArenaCommit(&Listing->TypeArena,       NewCapacity*sizeof(Listing->Type[0])) &&
+		ArenaCommit(&Listing->FlagsArena,      NewCapacity*sizeof(Listing->Flags[0])) &&
+		ArenaCommit(&Listing->SortKeyArena,    NewCapacity*sizeof(Listing->SortKey[0])) &&
+		ArenaCommit(&Listing->CharMaskArena,   NewCapacity*sizeof(Listing->CharMask[0])) &&
+		ArenaCommit(&Listing->SizeArena,         NewCapacity*sizeof(Listing->Size[0])) &&
+		ArenaCommit(&Listing->ModifiedTimeArena, NewCapacity*sizeof(Listing->ModifiedTime[0])) &&
+		ArenaCommit(&Listing->ModeArena,         NewCapacity*sizeof(Listing->Mode[0])) &&
+		ArenaCommit(&Listing->OwnerArena,        NewCapacity*sizeof(Listing->Owner[0]));
+	if (Committed)
 	{
-		KeepEntry = 0;
+		Listing->Capacity = (u32)NewCapacity;
 	}
+	return (Committed);
+}
 
-	// NOTE(Felix): Hidden items (any entry starting with ".")
-	if (FilterHiddenEntries && (EntryName[0] == '.'))
-	{ 
-		KeepEntry = 0;
+internal void
+DirectoryListingTrim(directory_listing *Listing)
+{
+	u64 KeepCapacity = MAX(DIRECTORY_LISTING_MIN_CAPACITY, 2*(u64)Listing->LoadedCount);
+	if (KeepCapacity < Listing->Capacity)
+	{
+		ArenaDecommitAbove(&Listing->NameOffsetArena, MAX(DIRECTORY_LISTING_KEEP_COMMITTED, KeepCapacity*sizeof(Listing->NameOffset[0])));
+		ArenaDecommitAbove(&Listing->NameLengthArena, MAX(DIRECTORY_LISTING_KEEP_COMMITTED, KeepCapacity*sizeof(Listing->NameLength[0])));
+		ArenaDecommitAbove(&Listing->TypeArena,       MAX(DIRECTORY_LISTING_KEEP_COMMITTED, KeepCapacity*sizeof(Listing->Type[0])));
+		ArenaDecommitAbove(&Listing->FlagsArena,      MAX(DIRECTORY_LISTING_KEEP_COMMITTED, KeepCapacity*sizeof(Listing->Flags[0])));
+		ArenaDecommitAbove(&Listing->SortKeyArena,    MAX(DIRECTORY_LISTING_KEEP_COMMITTED, KeepCapacity*sizeof(Listing->SortKey[0])));
+		ArenaDecommitAbove(&Listing->CharMaskArena,   MAX(DIRECTORY_LISTING_KEEP_COMMITTED, KeepCapacity*sizeof(Listing->CharMask[0])));
+		ArenaDecommitAbove(&Listing->SizeArena,         MAX(DIRECTORY_LISTING_KEEP_COMMITTED, KeepCapacity*sizeof(Listing->Size[0])));
+		ArenaDecommitAbove(&Listing->ModifiedTimeArena, MAX(DIRECTORY_LISTING_KEEP_COMMITTED, KeepCapacity*sizeof(Listing->ModifiedTime[0])));
+		ArenaDecommitAbove(&Listing->ModeArena,         MAX(DIRECTORY_LISTING_KEEP_COMMITTED, KeepCapacity*sizeof(Listing->Mode[0])));
+		ArenaDecommitAbove(&Listing->OwnerArena,        MAX(DIRECTORY_LISTING_KEEP_COMMITTED, KeepCapacity*sizeof(Listing->Owner[0])));
+		Listing->Capacity = (u32)KeepCapacity;
 	}
+	ArenaDecommitAbove(&Listing->NamesArena, MAX(DIRECTORY_LISTING_KEEP_COMMITTED, 2*Listing->NamesArena.Used));
+	ArenaDecommitAbove(&Listing->View.LevelArena, MAX(DIRECTORY_LISTING_KEEP_COMMITTED, 2*Listing->View.LevelArena.Used));
+}
 
-	// NOTE(Felix): Apply check if entry contains search string
-	if (SearchString)
+internal b32
+DirectoryListingPush(directory_listing *Listing, char *Name, u32 NameLength, entry_type Type)
+{
+	// NOTE(Felix): Appends behind LoadedCount, the entry only becomes part of the (sorted) 
+	// listing once it is sorted in, see SortDirectoryEntriesTail.
+	// Returns 0 if we ran out of memory (or reserved address space)
+	if (Listing->LoadedCount >= Listing->Capacity &&
+	    0 == DirectoryListingGrow(Listing))
+	{
+		return (0);
+	}
+
+	// NOTE(Felix): Names get searched with vector loads, so there always has to be some 
+	// readable space behind the last one
+	u64 NameOffset = Listing->NamesArena.Used;
+	if (0 == ArenaCommit(&Listing->NamesArena, NameOffset + NameLength + 1 + STRING_MATCH_READ_PADDING))
+	{
+		return (0);
+	}
+	char *Destination = ArenaPush(&Listing->NamesArena, NameLength + 1);
+	MemoryCopy(Destination, Name, NameLength);
+	Destination[NameLength] = 0;
+
+	u32 EntryIndex = Listing->LoadedCount++;
+	Listing->NameOffset[EntryIndex] = (u32)NameOffset;
+	Listing->NameLength[EntryIndex] = (u8)NameLength;
+	Listing->Type[EntryIndex] = (u8)Type;
+	Listing->Flags[EntryIndex] = (Name[0] == '.') ? ENTRY_FLAG_HIDDEN : 0;
+	Listing->SortKey[EntryIndex] = SortKeyFromName(Destination);
+	Listing->CharMask[EntryIndex] = FuzzyCharMask(Destination, NameLength);
+	return (1);
+}
+
+internal b32
+DirectoryListingStatGet(directory_listing *Listing, u32 EntryIndex, entry_stat *Stat)
+{
+	// NOTE(Felix): Only what was fetched already (see stat_batch), returns 0 if the metadata
+	// isn't there (yet) or couldn't be fetched
+	if (0 == (Listing->Flags[EntryIndex] & ENTRY_FLAG_STAT_CACHED))
+	{
+		return (0);
+	}
+	Stat->Size = Listing->Size[EntryIndex];
+	Stat->ModifiedTime = Listing->ModifiedTime[EntryIndex];
+	Stat->Mode = Listing->Mode[EntryIndex];
+	Stat->Owner = Listing->Owner[EntryIndex];
+	return (1);
+}
+
+internal b32
+DirectoryListingQueryMatch(directory_listing *Listing, metadata_query *Query, u32 EntryIndex, b32 *StatIsMissing)
+{
+	// NOTE(Felix): StatIsMissing is set if the answer depends on metadata that hasn't been 
+	// fetched yet, the entry doesn't match for now then
+	b32 IsDirectory = (Listing->Type[EntryIndex] == ENTRY_TYPE_DIRECTORY);
+	*StatIsMissing = 0;
+	if (0 == QueryMatchName(Query, DirectoryListingName(Listing, EntryIndex), Listing->NameLength[EntryIndex]) ||
+	    0 == QueryMatchEntry(Query, IsDirectory))
+	{
+		return (0);
+	}
+	if (0 == QueryNeedsStat(Query))
+	{
+		return (1);
+	}
+
+	entry_stat Stat = { 0 };
+	*StatIsMissing = (0 == (Listing->Flags[EntryIndex] & (ENTRY_FLAG_STAT_CACHED | ENTRY_FLAG_STAT_FAILED)));
+	return (DirectoryListingStatGet(Listing, EntryIndex, &Stat) && QueryMatchStat(Query, IsDirectory, &Stat));
+}
+
+internal char *
+OwnerNameGet(u32 Owner)
+{
+	// NOTE(Felix): Returns 0 if the name isn't known (yet)
+	owner_name *Slot = &GLOBALOwnerNames[Owner % OWNER_NAME_CACHE_SIZE];
+	return ((Slot->IsUsed && Slot->Owner == Owner) ? Slot->Name : 0);
+}
+
+internal void
+OwnerNameRemember(u32 Owner, char *Name)
+{
+	owner_name *Slot = &GLOBALOwnerNames[Owner % OWNER_NAME_CACHE_SIZE];
+	Slot->IsUsed = 1;
+	Slot->Owner = Owner;
+	StringCopyBounded(Slot->Name, Name, sizeof(Slot->Name));
+}
+
+internal void
+OwnerNameLookup(u32 Owner, char *Name)
+{
+	// NOTE(Felix): Safe to call from any thread, Name is empty if there's no such user
+	char Buffer[4096];
+	struct passwd Entry;
+	struct passwd *Found = 0;
+	Name[0] = 0;
+	if (getpwuid_r(Owner, &Entry, Buffer, sizeof(Buffer), &Found) == 0 && Found)
+	{
+		StringCopyBounded(Name, Found->pw_name, OWNER_NAME_MAX_LENGTH+1);
+	}
+}
+
+internal void
+StatBatchRun(job *Job)
+{
+	stat_batch *Batch = Job->Data;
+	if (Batch->UseRing)
 	{
-		if (0 == StringContains(EntryName, SearchString, FilterIsCaseSensitive))
+		for (u32 Index = 0; Index < Batch->Count; ++Index)
 		{
-			KeepEntry = 0;
+			StatRingQueue(&Batch->Ring, Batch->DirectoryFileDescriptor, Batch->Names[Index]);
+		}
+		if (0 == StatRingComplete(&Batch->Ring, Batch->Stats, Batch->Fetched))
+		{
+			StatRingDestroy(&Batch->Ring);
+			Batch->HasRing = 0;
+		}
+		Batch->DoneCount = Batch->Count;
+	}
+	else
+	{
+		for (u32 Index = 0; Index < Batch->Count && 0 == JobIsCancelled(Job); ++Index)
+		{
+			Batch->Fetched[Index] = EntryStatFetch(&Batch->Stats[Index], Batch->DirectoryFileDescriptor, Batch->Names[Index]);
+			Batch->DoneCount = Index+1;
 		}
 	}
 
-	return (KeepEntry);
+	for (u32 Index = 0; Index < Batch->DoneCount; ++Index)
+	{
+		if (Batch->Fetched[Index])
+		{
+			// NOTE(Felix): Most entries belong to the same user, only look up what changes
+			if (Index > 0 && Batch->Fetched[Index-1] && Batch->Stats[Index-1].Owner == Batch->Stats[Index].Owner)
+			{
+				StringCopy(Batch->OwnerNames[Index], Batch->OwnerNames[Index-1]);
+			}
+			else
+			{
+				OwnerNameLookup(Batch->Stats[Index].Owner, Batch->OwnerNames[Index]);
+			}
+		}
+	}
 }
 
-internal i32
-DirectoryGetFirstFileEntryIndex(internal_directory_entry *Buffer, u32 Count)
+internal void
+StatBatchComplete(job *Job)
 {
-	i32 ResultIndex = 0;
-	for (; 
-	     (Buffer[ResultIndex].Type != ENTRY_TYPE_FILE) && (ResultIndex < (i32)Count); 
-	     ++ResultIndex) 
-	{ 
-		// noop;
+	// NOTE(Felix): Entries the batch didn't get to are no longer pending, so they get
+	// requested again if they are still wanted
+	stat_batch *Batch = Job->Data;
+	directory_listing *Listing = Batch->Listing;
+	close(Batch->DirectoryFileDescriptor);
+	Batch->IsBusy = 0;
+	if (Batch->Generation != Listing->Generation)
+	{
+		return;
+	}
+
+	for (u32 Index = 0; Index < Batch->Count; ++Index)
+	{
+		u32 EntryIndex = Batch->EntryIndex[Index];
+		u8 Flags = Listing->Flags[EntryIndex] & (u8)~ENTRY_FLAG_STAT_PENDING;
+		if (Index < Batch->DoneCount && 0 == (Flags & (ENTRY_FLAG_STAT_CACHED | ENTRY_FLAG_STAT_FAILED)))
+		{
+			if (Batch->Fetched[Index])
+			{
+				entry_stat *Stat = &Batch->Stats[Index];
+				Listing->Size[EntryIndex] = Stat->Size;
+				Listing->ModifiedTime[EntryIndex] = Stat->ModifiedTime;
+				Listing->Mode[EntryIndex] = Stat->Mode;
+				Listing->Owner[EntryIndex] = Stat->Owner;
+				if (Batch->OwnerNames[Index][0])
+				{
+					OwnerNameRemember(Stat->Owner, Batch->OwnerNames[Index]);
+				}
+				Flags |= ENTRY_FLAG_STAT_CACHED;
+			}
+			else
+			{
+				Flags |= ENTRY_FLAG_STAT_FAILED;
+			}
+			if (Flags & ENTRY_FLAG_STAT_WANTED)
+			{
+				Listing->View.WantedStatsArrived = 1;
+			}
+		}
+		Listing->Flags[EntryIndex] = Flags;
 	}
-	return (ResultIndex);
 }
 
-internal void
-SortDirectoryEntries(internal_directory_entry *Buffer, u32 Count)
+internal stat_batch *
+StatBatchBegin(directory_listing *Listing, u32 FirstRow, u32 EndRow)
 {
-	InternalEntryListSort(Buffer, (i32)Count, &InternalEntryCompareType);
+	// NOTE(Felix): Returns 0 if every batch is busy
+	for (u32 BatchIndex = 0; BatchIndex < STAT_BATCH_COUNT; ++BatchIndex)
+	{
+		stat_batch *Batch = &GLOBALStatBatches[BatchIndex];
+		if (0 == Batch->IsBusy)
+		{
+			Batch->DirectoryFileDescriptor = fcntl(Listing->DirectoryFileDescriptor, F_DUPFD_CLOEXEC, 0);
+			if (Batch->DirectoryFileDescriptor < 0)
+			{
+				return (0);
+			}
+
+			// NOTE(Felix): If one ring can't be set up, none can
+			if (0 == Batch->RingIsSetUp && 0 == GLOBALStatRingDisabled)
+			{
+				Batch->HasRing = StatRingCreate(&Batch->Ring);
+				Batch->RingIsSetUp = 1;
+				GLOBALStatRingDisabled = !Batch->HasRing;
+			}
+			Batch->UseRing = (Batch->HasRing && 0 == GLOBALStatRingDisabled);
+			Batch->Job.Run = &StatBatchRun;
+			Batch->Job.Complete = &StatBatchComplete;
+			Batch->Job.Data = Batch;
+			Batch->Listing = Listing;
+			Batch->Generation = Listing->Generation;
+			Batch->FirstRow = FirstRow;
+			Batch->EndRow = EndRow;
+			Batch->IsForQuery = 0;
+			Batch->Count = 0;
+			Batch->DoneCount = 0;
+			return (Batch);
+		}
+	}
+	return (0);
+}
+
+internal void
+StatBatchAdd(stat_batch *Batch, directory_listing *Listing, u32 EntryIndex)
+{
+	Batch->EntryIndex[Batch->Count] = EntryIndex;
+	StringCopy(Batch->Names[Batch->Count], DirectoryListingName(Listing, EntryIndex));
+	++Batch->Count;
+}
+
+internal void
+StatBatchSubmit(job_system *Jobs, stat_batch *Batch)
+{
+	Batch->IsBusy = 1;
+	JobSubmit(Jobs, &Batch->Job);
+}
+
+internal void
+DirectoryListingStatRequest(directory_listing *Listing, job_system *Jobs, u32 FirstRow, u32 EndRow)
+{
+	// NOTE(Felix): Rows FirstRow to EndRow of the view are on screen. Their metadata is
+	// requested first, then that of the rows below and above. Call whenever the screen may
+	// have moved, entries that are cached or pending already are skipped
+	directory_view *View = &Listing->View;
+	EndRow = MIN(EndRow, View->Count);
+	FirstRow = MIN(FirstRow, EndRow);
+	u32 WantedFirstRow = (FirstRow > STAT_PREFETCH_ROWS) ? FirstRow - STAT_PREFETCH_ROWS : 0;
+	u32 WantedEndRow = MIN(EndRow + STAT_PREFETCH_ROWS, View->Count);
+
+	for (u32 BatchIndex = 0; BatchIndex < STAT_BATCH_COUNT; ++BatchIndex)
+	{
+		stat_batch *Batch = &GLOBALStatBatches[BatchIndex];
+		b32 RowsAreWanted = (Batch->IsForQuery || (Batch->EndRow > WantedFirstRow && Batch->FirstRow < WantedEndRow));
+		if (Batch->IsBusy &&
+		    (Batch->Listing != Listing || Batch->Generation != Listing->Generation || 0 == RowsAreWanted))
+		{
+			JobCancel(&Batch->Job);
+		}
+	}
+	if (Listing->DirectoryFileDescriptor < 0)
+	{
+		return;
+	}
+
+	u32 RangeFirst[3] = { FirstRow, EndRow, WantedFirstRow };
+	u32 RangeEnd[3] = { EndRow, WantedEndRow, FirstRow };
+	stat_batch *Batch = 0;
+	for (u32 Range = 0; Range < ARRAYCOUNT(RangeFirst); ++Range)
+	{
+		for (u32 Row = RangeFirst[Range]; Row < RangeEnd[Range]; ++Row)
+		{
+			u32 EntryIndex = View->Entries[Row];
+			if (Listing->Flags[EntryIndex] & (ENTRY_FLAG_STAT_CACHED | ENTRY_FLAG_STAT_FAILED | ENTRY_FLAG_STAT_PENDING))
+			{
+				continue;
+			}
+			if (0 == Batch)
+			{
+				Batch = StatBatchBegin(Listing, WantedFirstRow, WantedEndRow);
+				if (0 == Batch)
+				{
+					return;
+				}
+			}
+
+			StatBatchAdd(Batch, Listing, EntryIndex);
+			Listing->Flags[EntryIndex] |= ENTRY_FLAG_STAT_PENDING;
+			if (Batch->Count == STAT_BATCH_MAX_ENTRIES)
+			{
+				StatBatchSubmit(Jobs, Batch);
+				Batch = 0;
+			}
+		}
+	}
+	if (Batch)
+	{
+		StatBatchSubmit(Jobs, Batch);
+	}
+}
+
+internal void
+DirectoryListingStatRequestQuery(directory_listing *Listing, job_system *Jobs)
+{
+	// NOTE(Felix): Fetches the metadata a query is waiting for (ENTRY_FLAG_STAT_WANTED) with 
+	// whatever batches are free, in listing order. Call whenever batches may have become free
+	if (0 == Listing->View.MissingStatCount)
+	{
+		return;
+	}
+
+	stat_batch *Batch = 0;
+	for (u32 EntryIndex = 0; EntryIndex < Listing->Count; ++EntryIndex)
+	{
+		u8 Flags = Listing->Flags[EntryIndex];
+		if (0 == (Flags & ENTRY_FLAG_STAT_WANTED) ||
+		    (Flags & (ENTRY_FLAG_STAT_CACHED | ENTRY_FLAG_STAT_FAILED | ENTRY_FLAG_STAT_PENDING)))
+		{
+			continue;
+		}
+		if (Listing->DirectoryFileDescriptor < 0)
+		{
+			// NOTE(Felix): Nothing can be fetched without the directory
+			Listing->Flags[EntryIndex] = Flags | ENTRY_FLAG_STAT_FAILED;
+			Listing->View.WantedStatsArrived = 1;
+			continue;
+		}
+		if (0 == Batch)
+		{
+			Batch = StatBatchBegin(Listing, 0, 0);
+			if (0 == Batch)
+			{
+				return;
+			}
+			Batch->IsForQuery = 1;
+		}
+
+		StatBatchAdd(Batch, Listing, EntryIndex);
+		Listing->Flags[EntryIndex] = Flags | ENTRY_FLAG_STAT_PENDING;
+		if (Batch->Count == STAT_BATCH_MAX_ENTRIES)
+		{
+			StatBatchSubmit(Jobs, Batch);
+			Batch = 0;
+		}
+	}
+	if (Batch)
+	{
+		StatBatchSubmit(Jobs, Batch);
+	}
+}
+
+internal void
+DirectoryListingColumnsFormat(directory_listing *Listing, u32 EntryIndex, i64 Now, char *Buffer, u32 BufferSize)
+{
+	// NOTE(Felix): Long listing columns in front of the name, "drwxr-xr-x felix     4.0K Oct 16 14:03 ".
+	// Placeholders while the metadata is still being fetched, '?' if that failed
+	u8 Flags = Listing->Flags[EntryIndex];
+	if (Flags & ENTRY_FLAG_STAT_CACHED)
+	{
+		char Mode[11];
+		char Size[16];
+		char Time[32];
+		char OwnerId[16];
+		EntryModeFormat(Listing->Mode[EntryIndex], Mode);
+		EntrySizeFormat(Listing->Size[EntryIndex], Size, sizeof(Size));
+		EntryTimeFormat(Listing->ModifiedTime[EntryIndex], Now, Time, sizeof(Time));
+		char *Owner = OwnerNameGet(Listing->Owner[EntryIndex]);
+		if (0 == Owner)
+		{
+			snprintf(OwnerId, sizeof(OwnerId), "%" PFu32, Listing->Owner[EntryIndex]);
+			Owner = OwnerId;
+		}
+		snprintf(Buffer, BufferSize, "%s %-8.8s %5s %s ", Mode, Owner, Size, Time);
+		return;
+	}
+
+	// NOTE(Felix): Same column widths as above
+	char *Placeholder = (Flags & ENTRY_FLAG_STAT_FAILED) ? "?" : "…";
+	u32 ColumnWidth[] = { 10, 8, 5, 12 };
+	u32 Used = 0;
+	Buffer[0] = 0;
+	for (u32 Column = 0; Column < ARRAYCOUNT(ColumnWidth); ++Column)
+	{
+		i32 Written = snprintf(Buffer + Used, BufferSize - Used, "%s%*s", Placeholder, (i32)ColumnWidth[Column], "");
+		Used = MIN(BufferSize-1, Used + (u32)MAX(Written, 0));
+	}
+}
+
+internal b32
+DirectoryIdentityGet(i32 FileDescriptor, directory_identity *Identity)
+{
+	struct stat Stat;
+	if (fstat(FileDescriptor, &Stat) != 0)
+	{
+		return (0);
+	}
+	Identity->Device = (u64)Stat.st_dev;
+	Identity->Inode = (u64)Stat.st_ino;
+	Identity->ModifiedTime = (i64)Stat.st_mtim.tv_sec*1000000000 + Stat.st_mtim.tv_nsec;
+	Identity->ChangeTime = (i64)Stat.st_ctim.tv_sec*1000000000 + Stat.st_ctim.tv_nsec;
+	return (1);
+}
+
+internal void
+DirectoryListingOpenDirectory(directory_listing *Listing, char *DirectoryPath)
+{
+	// NOTE(Felix): Only used as the base for statx, stays open while the listing shows this directory
+	if (Listing->DirectoryFileDescriptor >= 0)
+	{
+		close(Listing->DirectoryFileDescriptor);
+	}
+	Listing->DirectoryFileDescriptor = open(DirectoryPath, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	Listing->IdentityIsValid = (Listing->DirectoryFileDescriptor >= 0 &&
+	                            DirectoryIdentityGet(Listing->DirectoryFileDescriptor, &Listing->Identity));
+}
+
+internal void
+NameFilterInit(name_filter *Filter, filter_mode Mode, char *SearchTerm, b32 IsCaseSensitive)
+{
+	// NOTE(Felix): Fuzzy, pattern and query matching decide about case sensitivity themselves
+	// (smart case). Patterns and queries get compiled right here, once per filter
+	Filter->Mode = Mode;
+	SubstringMatcherInit(&Filter->Substring, SearchTerm, IsCaseSensitive);
+	FuzzyPatternInit(&Filter->Fuzzy, SearchTerm);
+	if (Mode == FILTER_MODE_PATTERN)
+	{
+		if (0 == Filter->Pattern)
+		{
+			Filter->Pattern = PatternMatcherAllocate();
+		}
+		PatternCompile(Filter->Pattern, SearchTerm);
+	}
+	if (Mode == FILTER_MODE_QUERY)
+	{
+		QueryCompile(&Filter->Query, SearchTerm);
+	}
+}
+
+internal b32
+NameFilterIsValid(name_filter *Filter)
+{
+	b32 Result = 1;
+	if (Filter->Mode == FILTER_MODE_PATTERN) { Result = Filter->Pattern->IsValid; }
+	if (Filter->Mode == FILTER_MODE_QUERY)   { Result = Filter->Query.IsValid; }
+	return (Result);
+}
+
+internal b32
+FilterModeNarrows(filter_mode Mode)
+{
+	// NOTE(Felix): Does adding a character to the filter only ever remove entries?
+	return (Mode == FILTER_MODE_SUBSTRING || Mode == FILTER_MODE_FUZZY);
+}
+
+internal void
+NameFilterRelease(name_filter *Filter)
+{
+	if (Filter->Pattern)
+	{
+		PatternMatcherFree(Filter->Pattern);
+		Filter->Pattern = 0;
+	}
+}
+
+internal b32
+NameFilterMatch(name_filter *Filter, char *Name, u32 NameLength)
+{
+	b32 Result = 0;
+	switch (Filter->Mode)
+	{
+		case FILTER_MODE_SUBSTRING: {
+			Result = SubstringMatch(&Filter->Substring, Name, NameLength);
+		} break;
+
+		case FILTER_MODE_FUZZY: {
+			Result = (FuzzyScore(&Filter->Fuzzy, Name, NameLength) != FUZZY_NO_MATCH);
+		} break;
+
+		case FILTER_MODE_PATTERN: {
+			Result = PatternMatch(Filter->Pattern, Name, NameLength);
+		} break;
+
+		case FILTER_MODE_QUERY: {
+			// NOTE(Felix): Only the name terms, the rest needs the entry (see FilterKeepEntry
+			// and DirectoryListingQueryMatch)
+			Result = QueryMatchName(&Filter->Query, Name, NameLength);
+		} break;
+	}
+	return (Result);
+}
+
+// NOTE(Felix): Views
+// Filtering only ever builds index lists into the listing, nothing gets re-read from disk
+// and the listing itself stays untouched
+
+internal void
+DirectoryViewRankByScore(directory_listing *Listing, memory_arena *Arena, u32 *Entries, i32 *Scores,
+                         u32 Count, i32 MinScore, i32 MaxScore)
+{
+	// NOTE(Felix): Best score first, shorter names first among equal scores, otherwise the
+	// order stays the same. Two stable counting sort passes (by length, then by score),
+	// the scratch memory is pushed onto Arena and popped again
+	u64 ArenaUsed = Arena->Used;
+	u32 BucketCount = MAX(256, (u32)(MaxScore - MinScore) + 1);
+	u32 *TempEntries = ArenaPush(Arena, sizeof(u32)*(u64)Count);
+	i32 *TempScores = ArenaPush(Arena, sizeof(i32)*(u64)Count);
+	u32 *BucketStart = ArenaPush(Arena, sizeof(u32)*(u64)BucketCount);
+	Assert(TempEntries && TempScores && BucketStart);
+
+	MemoryClear(BucketStart, sizeof(u32)*256);
+	for (u32 Index = 0; Index < Count; ++Index) { ++BucketStart[Listing->NameLength[Entries[Index]]]; }
+	for (u32 Bucket = 0, Sum = 0; Bucket < 256; ++Bucket) { u32 Size = BucketStart[Bucket]; BucketStart[Bucket] = Sum; Sum += Size; }
+	for (u32 Index = 0; Index < Count; ++Index)
+	{
+		u32 Slot = BucketStart[Listing->NameLength[Entries[Index]]]++;
+		TempEntries[Slot] = Entries[Index];
+		TempScores[Slot] = Scores[Index];
+	}
+
+	MemoryClear(BucketStart, sizeof(u32)*BucketCount);
+	for (u32 Index = 0; Index < Count; ++Index) { ++BucketStart[MaxScore - TempScores[Index]]; }
+	for (u32 Bucket = 0, Sum = 0; Bucket < BucketCount; ++Bucket) { u32 Size = BucketStart[Bucket]; BucketStart[Bucket] = Sum; Sum += Size; }
+	for (u32 Index = 0; Index < Count; ++Index)
+	{
+		u32 Slot = BucketStart[MaxScore - TempScores[Index]]++;
+		Entries[Slot] = TempEntries[Index];
+		Scores[Slot] = TempScores[Index];
+	}
+
+	Arena->Used = ArenaUsed;
+}
+
+// NOTE(Felix): Parallel filtering
+// A level gets filtered in contiguous chunks. The calling thread and a fixed pool of workers 
+// (one per additional core, started the first time a level is big enough) take chunks off a
+// shared counter until none are left. Every chunk writes the entries it keeps to where it
+// read them from in Source, afterwards the pieces get moved together in chunk order, so the
+// level comes out exactly as if it had been filtered in one go.
+// Compiled patterns change while matching (the lazy DFA), so every thread matches with its
+// own copy of the filter.
+// If the pass may be cancelled, the calling thread checks for input every block: once a key
+// is waiting, the remaining chunks are skipped and the level is thrown away again (see
+// DirectoryViewFinish). Below the threshold waking up workers costs more than it saves, the
+// calling thread does all the chunks itself
+#define PARALLEL_FILTER_THRESHOLD (1 << 15)
+#define PARALLEL_FILTER_MAX_THREADS 64
+#define PARALLEL_FILTER_MAX_CHUNKS 1024
+#define PARALLEL_FILTER_MIN_CHUNK_SIZE (1 << 13)
+#define PARALLEL_FILTER_BLOCK_SIZE 1024
+
+typedef struct
+{
+	directory_listing *Listing;
+	u32 *Source;
+	u32 SourceCount;
+	u32 *Destination; // At least SourceCount entries
+	i32 *Scores;      // Same, only used in fuzzy mode
+	char *Filter;
+	filter_mode FilterMode;
+	b32 FilterIsCaseSensitive;
+	b32 CancelOnInput;
+
+	// NOTE(Felix): Results
+	u32 Count;
+	i32 MinScore;
+	i32 MaxScore;
+	b32 FilterIsValid;
+	u32 MissingStatCount; // Query mode, see DirectoryListingQueryMatch
+} filter_pass;
+
+typedef struct
+{
+	u32 Count;
+	i32 MinScore;
+	i32 MaxScore;
+	u32 MissingStatCount;
+} filter_chunk;
+
+typedef struct
+{
+	b32 IsStarted;
+	u32 WorkerCount;
+	pthread_t Workers[PARALLEL_FILTER_MAX_THREADS];
+	pthread_mutex_t Mutex;
+	pthread_cond_t PassStarted;
+	pthread_cond_t PassFinished;
+	u64 PassIndex;
+	u32 BusyWorkerCount;
+
+	// NOTE(Felix): The pass that is running. NextChunk and IsCancelled are accessed atomically
+	filter_pass *Pass;
+	filter_chunk Chunks[PARALLEL_FILTER_MAX_CHUNKS];
+	u32 ChunkCount;
+	u32 ChunkSize;
+	u32 NextChunk;
+	b32 IsCancelled;
+
+	// NOTE(Felix): One per thread, the calling thread uses the first one
+	name_filter Filters[PARALLEL_FILTER_MAX_THREADS];
+} filter_pool;
+
+global_variable filter_pool GLOBALFilterPool;
+
+internal b32
+InputIsPending(void)
+{
+	// NOTE(Felix): Keys that were read already but not handled yet count as well
+	if (InputEventIsPending(&GLOBALInput))
+	{
+		return (1);
+	}
+	struct pollfd PollRequest = { 0 };
+	PollRequest.fd = STDIN_FILENO;
+	PollRequest.events = POLLIN;
+	return (poll(&PollRequest, 1, 0) > 0);
+}
+
+internal b32
+FilterPoolIsCancelled(filter_pool *Pool, b32 CheckInput)
+{
+	if (CheckInput && InputIsPending())
+	{
+		__atomic_store_n(&Pool->IsCancelled, 1, __ATOMIC_RELAXED);
+	}
+	return (__atomic_load_n(&Pool->IsCancelled, __ATOMIC_RELAXED));
+}
+
+internal void
+FilterPoolChunkFilter(filter_pool *Pool, name_filter *NameFilter, u32 ChunkIndex, b32 CheckInput)
+{
+	filter_pass *Pass = Pool->Pass;
+	directory_listing *Listing = Pass->Listing;
+	filter_chunk *Chunk = &Pool->Chunks[ChunkIndex];
+	u32 ChunkBegin = ChunkIndex*Pool->ChunkSize;
+	u32 ChunkEnd = MIN(Pass->SourceCount, ChunkBegin + Pool->ChunkSize);
+	u32 *Destination = Pass->Destination + ChunkBegin;
+	i32 *Scores = Pass->Scores ? Pass->Scores + ChunkBegin : 0;
+
+	u32 Count = 0;
+	i32 MinScore = 0;
+	i32 MaxScore = 0;
+	u32 MissingStatCount = 0;
+	for (u32 BlockBegin = ChunkBegin; BlockBegin < ChunkEnd; BlockBegin += PARALLEL_FILTER_BLOCK_SIZE)
+	{
+		if (FilterPoolIsCancelled(Pool, CheckInput))
+		{
+			break;
+		}
+
+		u32 BlockEnd = MIN(ChunkEnd, BlockBegin + PARALLEL_FILTER_BLOCK_SIZE);
+		if (NameFilter->Mode == FILTER_MODE_FUZZY)
+		{
+			fuzzy_pattern *Pattern = &NameFilter->Fuzzy;
+			for (u32 SourceIndex = BlockBegin; SourceIndex < BlockEnd; ++SourceIndex)
+			{
+				u32 EntryIndex = Pass->Source[SourceIndex];
+				if (FuzzyMaskCanMatch(Pattern, Listing->CharMask[EntryIndex]))
+				{
+					i32 Score = FuzzyScore(Pattern, DirectoryListingName(Listing, EntryIndex), Listing->NameLength[EntryIndex]);
+					if (Score != FUZZY_NO_MATCH)
+					{
+						MinScore = (Count == 0) ? Score : MIN(MinScore, Score);
+						MaxScore = (Count == 0) ? Score : MAX(MaxScore, Score);
+						Destination[Count] = EntryIndex;
+						Scores[Count] = Score;
+						++Count;
+					}
+				}
+			}
+		}
+		else if (NameFilter->Mode == FILTER_MODE_QUERY)
+		{
+			// NOTE(Felix): Nothing gets fetched here, entries still waiting for their metadata are
+			// marked instead (see DirectoryListingStatRequestQuery). Chunks never share entries, so
+			// marking them is fine
+			for (u32 SourceIndex = BlockBegin; SourceIndex < BlockEnd; ++SourceIndex)
+			{
+				u32 EntryIndex = Pass->Source[SourceIndex];
+				b32 StatIsMissing = 0;
+				if (DirectoryListingQueryMatch(Listing, &NameFilter->Query, EntryIndex, &StatIsMissing))
+				{
+					Destination[Count++] = EntryIndex;
+				}
+				u8 Flags = Listing->Flags[EntryIndex];
+				u8 NewFlags = StatIsMissing ? (Flags | ENTRY_FLAG_STAT_WANTED) : (Flags & (u8)~ENTRY_FLAG_STAT_WANTED);
+				if (NewFlags != Flags)
+				{
+					Listing->Flags[EntryIndex] = NewFlags;
+				}
+				MissingStatCount += (StatIsMissing ? 1 : 0);
+			}
+		}
+		else
+		{
+			for (u32 SourceIndex = BlockBegin; SourceIndex < BlockEnd; ++SourceIndex)
+			{
+				u32 EntryIndex = Pass->Source[SourceIndex];
+				if (NameFilterMatch(NameFilter, DirectoryListingName(Listing, EntryIndex), Listing->NameLength[EntryIndex]))
+				{
+					Destination[Count++] = EntryIndex;
+				}
+			}
+		}
+	}
+
+	Chunk->Count = Count;
+	Chunk->MinScore = MinScore;
+	Chunk->MaxScore = MaxScore;
+	Chunk->MissingStatCount = MissingStatCount;
+}
+
+internal void
+FilterPoolWork(filter_pool *Pool, u32 ThreadIndex)
+{
+	// NOTE(Felix): The calling thread compiled its filter already, workers only do it
+	// once they actually got a chunk
+	filter_pass *Pass = Pool->Pass;
+	name_filter *NameFilter = &Pool->Filters[ThreadIndex];
+	b32 FilterIsCompiled = (ThreadIndex == 0);
+	b32 CheckInput = (ThreadIndex == 0) && Pass->CancelOnInput;
+	for (;;)
+	{
+		u32 ChunkIndex = __atomic_fetch_add(&Pool->NextChunk, 1, __ATOMIC_RELAXED);
+		if (ChunkIndex >= Pool->ChunkCount || FilterPoolIsCancelled(Pool, CheckInput))
+		{
+			break;
+		}
+		if (0 == FilterIsCompiled)
+		{
+			NameFilterInit(NameFilter, Pass->FilterMode, Pass->Filter, Pass->FilterIsCaseSensitive);
+			FilterIsCompiled = 1;
+		}
+		FilterPoolChunkFilter(Pool, NameFilter, ChunkIndex, CheckInput);
+	}
+}
+
+internal void *
+FilterWorkerThread(void *Parameter)
+{
+	filter_pool *Pool = &GLOBALFilterPool;
+	u32 ThreadIndex = (u32)(umm)Parameter;
+	u64 LastPassIndex = 0;
+	for (;;)
+	{
+		pthread_mutex_lock(&Pool->Mutex);
+		while (Pool->PassIndex == LastPassIndex)
+		{
+			pthread_cond_wait(&Pool->PassStarted, &Pool->Mutex);
+		}
+		LastPassIndex = Pool->PassIndex;
+		pthread_mutex_unlock(&Pool->Mutex);
+
+		FilterPoolWork(Pool, ThreadIndex);
+
+		pthread_mutex_lock(&Pool->Mutex);
+		if (--Pool->BusyWorkerCount == 0)
+		{
+			pthread_cond_signal(&Pool->PassFinished);
+		}
+		pthread_mutex_unlock(&Pool->Mutex);
+	}
+	return (0);
+}
+
+internal void
+FilterPoolStart(filter_pool *Pool)
+{
+	// NOTE(Felix): Workers live as long as the program, waiting for the next pass
+	pthread_mutex_init(&Pool->Mutex, 0);
+	pthread_cond_init(&Pool->PassStarted, 0);
+	pthread_cond_init(&Pool->PassFinished, 0);
+	long ProcessorCount = sysconf(_SC_NPROCESSORS_ONLN);
+	u32 WorkerCount = (u32)CLAMP(1, ProcessorCount, PARALLEL_FILTER_MAX_THREADS) - 1;
+	for (u32 WorkerIndex = 0; WorkerIndex < WorkerCount; ++WorkerIndex)
+	{
+		if (pthread_create(&Pool->Workers[Pool->WorkerCount], 0, &FilterWorkerThread, (void *)(umm)(WorkerIndex+1)) == 0)
+		{
+			++Pool->WorkerCount;
+		}
+	}
+	Pool->IsStarted = 1;
+}
+
+internal b32
+FilterPassRun(filter_pass *Pass)
+{
+	// NOTE(Felix): Returns 0 if the pass got cancelled, Destination and Scores hold garbage then
+	filter_pool *Pool = &GLOBALFilterPool;
+	NameFilterInit(&Pool->Filters[0], Pass->FilterMode, Pass->Filter, Pass->FilterIsCaseSensitive);
+	Pass->FilterIsValid = NameFilterIsValid(&Pool->Filters[0]);
+
+	u32 ChunkSize = MAX(PARALLEL_FILTER_MIN_CHUNK_SIZE, 
+	                    Pass->SourceCount / PARALLEL_FILTER_MAX_CHUNKS + 1);
+	Pool->Pass = Pass;
+	Pool->ChunkSize = ChunkSize;
+	Pool->ChunkCount = (Pass->SourceCount + ChunkSize-1) / ChunkSize;
+	Pool->NextChunk = 0;
+	Pool->IsCancelled = 0;
+
+	b32 UseWorkers = (Pass->SourceCount >= PARALLEL_FILTER_THRESHOLD);
+	if (UseWorkers && 0 == Pool->IsStarted)
+	{
+		FilterPoolStart(Pool);
+	}
+	UseWorkers = UseWorkers && (Pool->WorkerCount > 0);
+	if (UseWorkers)
+	{
+		pthread_mutex_lock(&Pool->Mutex);
+		Pool->BusyWorkerCount = Pool->WorkerCount;
+		++Pool->PassIndex;
+		pthread_cond_broadcast(&Pool->PassStarted);
+		pthread_mutex_unlock(&Pool->Mutex);
+	}
+
+	FilterPoolWork(Pool, 0);
+
+	if (UseWorkers)
+	{
+		pthread_mutex_lock(&Pool->Mutex);
+		while (Pool->BusyWorkerCount > 0)
+		{
+			pthread_cond_wait(&Pool->PassFinished, &Pool->Mutex);
+		}
+		pthread_mutex_unlock(&Pool->Mutex);
+	}
+
+	if (Pool->IsCancelled)
+	{
+		return (0);
+	}
+
+	// NOTE(Felix): Move the pieces together, they only ever move down
+	Pass->Count = 0;
+	Pass->MissingStatCount = 0;
+	for (u32 ChunkIndex = 0; ChunkIndex < Pool->ChunkCount; ++ChunkIndex)
+	{
+		filter_chunk *Chunk = &Pool->Chunks[ChunkIndex];
+		Pass->MissingStatCount += Chunk->MissingStatCount;
+		u32 ChunkBegin = ChunkIndex*ChunkSize;
+		for (u32 Index = 0; Index < Chunk->Count; ++Index)
+		{
+			Pass->Destination[Pass->Count + Index] = Pass->Destination[ChunkBegin + Index];
+		}
+		if (Pass->Scores && Chunk->Count > 0)
+		{
+			for (u32 Index = 0; Index < Chunk->Count; ++Index)
+			{
+				Pass->Scores[Pass->Count + Index] = Pass->Scores[ChunkBegin + Index];
+			}
+			Pass->MinScore = (Pass->Count == 0) ? Chunk->MinScore : MIN(Pass->MinScore, Chunk->MinScore);
+			Pass->MaxScore = (Pass->Count == 0) ? Chunk->MaxScore : MAX(Pass->MaxScore, Chunk->MaxScore);
+		}
+		Pass->Count += Chunk->Count;
+	}
+	return (1);
+}
+
+internal b32
+DirectoryViewLevelBuild(directory_listing *Listing, u32 Level, b32 CancelOnInput)
+{
+	// NOTE(Felix): Level 0 is every entry that isn't hidden away, level k keeps the entries
+	// of level k-1 that match the first k characters of the filter. Gets pushed right after
+	// level k-1, so every level above has to be thrown away beforehand.
+	// In pattern and query mode level k-1 has to be a copy of level 0, see DirectoryViewBuildLevels.
+	// Returns 0 if input cancelled the build (only if CancelOnInput), level k isn't there then
+	directory_view *View = &Listing->View;
+	directory_view_level *Result = &View->Levels[Level];
+
+	u32 *Source = 0;
+	u32 SourceCount = Listing->Count;
+	if (Level > 0)
+	{
+		directory_view_level *Below = &View->Levels[Level-1];
+		Source = (u32 *)(void *)(View->LevelArena.Base + Below->Offset);
+		SourceCount = Below->Count;
+		View->LevelArena.Used = Below->ArenaEnd;
+	}
+	else
+	{
+		ArenaReset(&View->LevelArena);
+		View->MissingStatCount = 0;
+	}
+	if (Level <= 1)
+	{
+		View->LevelsAreCollapsed = 0;
+	}
+
+	// NOTE(Felix): Everything this level may push, in fuzzy mode that includes the scores and
+	// the scratch memory of the ranking
+	u64 NeededSize = sizeof(u32)*(u64)SourceCount*((Level > 0 && View->FilterMode == FILTER_MODE_FUZZY) ? 5 : 1);
+	if (Level > 1 && View->LevelArena.Used + NeededSize + DIRECTORY_VIEW_LEVELS_SLACK > View->LevelArena.Reserved)
+	{
+		for (u32 Below = 1; Below < Level; ++Below)
+		{
+			View->Levels[Below] = View->Levels[0];
+		}
+		Source = (u32 *)(void *)(View->LevelArena.Base + View->Levels[0].Offset);
+		SourceCount = View->Levels[0].Count;
+		View->LevelArena.Used = View->Levels[0].ArenaEnd;
+		View->LevelsAreCollapsed = 1;
+	}
+
+	u64 Offset = View->LevelArena.Used;
+	u32 *Destination = ArenaPush(&View->LevelArena, sizeof(u32)*(u64)SourceCount);
+	Assert(Destination || SourceCount == 0);
+
+	u32 Count = 0;
+	b32 IsRanked = 0;
+	if (Level == 0)
+	{
+		// NOTE(Felix): Streamed listings are already filtered while reading
+		b32 HideHidden = View->HideHiddenEntries && (0 == Listing->IsStreamed);
+		for (u32 EntryIndex = 0; EntryIndex < SourceCount; ++EntryIndex)
+		{
+			if (0 == HideHidden || 0 == (Listing->Flags[EntryIndex] & ENTRY_FLAG_HIDDEN))
+			{
+				Destination[Count++] = EntryIndex;
+			}
+		}
+	}
+	else
+	{
+		char Filter[DIRECTORY_VIEW_MAX_FILTER_LENGTH] = { 0 };
+		MemoryCopy(Filter, View->Filter, Level);
+
+		filter_pass Pass = { 0 };
+		Pass.Listing = Listing;
+		Pass.Source = Source;
+		Pass.SourceCount = SourceCount;
+		Pass.Destination = Destination;
+		Pass.Filter = Filter;
+		Pass.FilterMode = View->FilterMode;
+		Pass.FilterIsCaseSensitive = View->FilterIsCaseSensitive;
+		Pass.CancelOnInput = CancelOnInput;
+		if (View->FilterMode == FILTER_MODE_FUZZY)
+		{
+			// NOTE(Felix): Scores only live until the level is ranked, they go right behind it
+			Pass.Scores = ArenaPush(&View->LevelArena, sizeof(i32)*(u64)SourceCount);
+			Assert(Pass.Scores || SourceCount == 0);
+		}
+
+		b32 Completed = FilterPassRun(&Pass);
+		View->FilterIsInvalid = (0 == Pass.FilterIsValid);
+		if (0 == Completed)
+		{
+			View->LevelArena.Used = Offset;
+			View->BuiltLevelCount = Level;
+			return (0);
+		}
+
+		Count = Pass.Count;
+		View->MissingStatCount = Pass.MissingStatCount;
+		if (Pass.Scores)
+		{
+			DirectoryViewRankByScore(Listing, &View->LevelArena, Destination, Pass.Scores, Count, Pass.MinScore, Pass.MaxScore);
+			IsRanked = 1;
+		}
+	}
+
+	if (Level > 0 && Count == SourceCount && 0 == IsRanked)
+	{
+		// NOTE(Felix): Nothing got filtered out, so this level is the same as the one below
+		View->LevelArena.Used = Offset;
+		*Result = View->Levels[Level-1];
+	}
+	else
+	{
+		View->LevelArena.Used = Offset + sizeof(u32)*(u64)Count;
+		Result->Offset = Offset;
+		Result->Count = Count;
+		Result->ArenaEnd = View->LevelArena.Used;
+	}
+	View->BuiltLevelCount = Level+1;
+	return (1);
+}
+
+internal b32
+DirectoryViewBuildLevels(directory_listing *Listing, u32 FirstLevel, b32 CancelOnInput)
+{
+	// NOTE(Felix): Builds levels FirstLevel up to the top one. Patterns and queries only make
+	// sense as a whole, so for them the levels in between are copies of level 0.
+	// Returns 0 if input cancelled it, the levels from BuiltLevelCount on are missing then
+	directory_view *View = &Listing->View;
+	for (u32 Level = MAX(FirstLevel, 1); Level <= View->FilterLength; ++Level)
+	{
+		if (0 == FilterModeNarrows(View->FilterMode) && Level < View->FilterLength)
+		{
+			View->Levels[Level] = View->Levels[0];
+			View->BuiltLevelCount = Level+1;
+		}
+		else if (0 == DirectoryViewLevelBuild(Listing, Level, CancelOnInput))
+		{
+			return (0);
+		}
+	}
+	return (1);
+}
+
+internal void
+DirectoryViewShowLevel(directory_view *View, u32 Level)
+{
+	View->Entries = (u32 *)(void *)(View->LevelArena.Base + View->Levels[Level].Offset);
+	View->Count = View->Levels[Level].Count;
+}
+
+internal void
+DirectoryViewShowTopLevel(directory_view *View)
+{
+	// NOTE(Felix): The top level that got built, a cancelled build shows a level below the filter 
+	u32 Level = MIN(View->FilterLength, MAX(View->BuiltLevelCount, 1) - 1);
+	View->LevelArena.Used = View->Levels[Level].ArenaEnd;
+	DirectoryViewShowLevel(View, Level);
+}
+
+internal b32
+DirectoryViewIsComplete(directory_listing *Listing)
+{
+	return (Listing->IsStreamed || Listing->View.BuiltLevelCount > Listing->View.FilterLength);
+}
+
+internal b32
+DirectoryViewFinish(directory_listing *Listing, b32 CancelOnInput)
+{
+	// NOTE(Felix): Builds the levels a cancelled filter pass left out. Returns 0 if more
+	// input cancelled it again
+	directory_view *View = &Listing->View;
+	if (DirectoryViewIsComplete(Listing))
+	{
+		return (1);
+	}
+	b32 Result = DirectoryViewBuildLevels(Listing, View->BuiltLevelCount, CancelOnInput);
+	DirectoryViewShowTopLevel(View);
+	return (Result);
+}
+
+internal void
+DirectoryViewRebuild(directory_listing *Listing)
+{
+	// NOTE(Felix): Has to be called whenever the listing itself changed (loaded, sorted, ...)
+	directory_view *View = &Listing->View;
+	DirectoryViewLevelBuild(Listing, 0, 0);
+	u32 TopLevel = 0;
+	if (0 == Listing->IsStreamed)
+	{
+		DirectoryViewBuildLevels(Listing, 1, 0);
+		TopLevel = View->FilterLength;
+	}
+	DirectoryViewShowLevel(View, TopLevel);
+}
+
+internal void
+DirectoryViewSetFilter(directory_listing *Listing, b32 HideHiddenEntries, 
+                       char *Filter, b32 FilterIsCaseSensitive, filter_mode FilterMode, b32 CancelOnInput)
+{
+	// NOTE(Felix): Levels of the part both filters have in common are kept, so typing a 
+	// character only filters the last level and deleting one doesn't have to do anything.
+	// Patterns and queries have nothing in common but level 0, every edit filters level 0 again.
+	// With CancelOnInput the view may be left incomplete, see DirectoryViewFinish
+	directory_view *View = &Listing->View;
+	u32 FilterLength = Filter ? MIN(StringLength(Filter), DIRECTORY_VIEW_MAX_FILTER_LENGTH-1) : 0;
+
+	b32 HiddenChanged = (View->HideHiddenEntries != HideHiddenEntries);
+	u32 CommonLength = 0;
+	View->FilterIsInvalid = 0;
+	if (0 == HiddenChanged && View->FilterIsCaseSensitive == FilterIsCaseSensitive &&
+	    View->FilterMode == FilterMode && FilterModeNarrows(FilterMode) && 0 == View->LevelsAreCollapsed)
+	{
+		u32 BuiltLength = MAX(View->BuiltLevelCount, 1) - 1;
+		while (CommonLength < FilterLength && CommonLength < BuiltLength &&
+		       Filter[CommonLength] == View->Filter[CommonLength])
+		{
+			++CommonLength;
+		}
+	}
+
+	View->HideHiddenEntries = HideHiddenEntries;
+	View->FilterIsCaseSensitive = FilterIsCaseSensitive;
+	View->FilterMode = FilterMode;
+	if (Filter)
+	{
+		MemoryCopy(View->Filter, Filter, FilterLength);
+	}
+	View->Filter[FilterLength] = 0;
+	View->FilterLength = FilterLength;
+	View->BuiltLevelCount = MIN(View->BuiltLevelCount, CommonLength+1);
+	View->MissingStatCount = 0;
+
+	if (Listing->IsStreamed)
+	{
+		DirectoryViewRebuild(Listing);
+		return;
+	}
+
+	if (HiddenChanged)
+	{
+		DirectoryViewLevelBuild(Listing, 0, 0);
+	}
+	DirectoryViewBuildLevels(Listing, CommonLength+1, CancelOnInput);
+	DirectoryViewShowTopLevel(View);
+}
+
+internal i32
+DirectoryViewRowFromEntry(directory_listing *Listing, u32 EntryIndex)
+{
+	// NOTE(Felix): Returns -1 if the entry isn't shown
+	directory_view *View = &Listing->View;
+	for (u32 Row = 0; Row < View->Count; ++Row)
+	{
+		if (View->Entries[Row] == EntryIndex)
+		{
+			return ((i32)Row);
+		}
+	}
+	return (-1);
+}
+
+internal b32
+FilterKeepEntry(char *EntryName, u32 EntryNameLength, b32 FilterHiddenEntries, 
+                name_filter *SearchFilter, b32 IsDirectory, i32 DirectoryFileDescriptor)
+{
+	// NOTE(Felix): EntryName needs STRING_MATCH_READ_PADDING readable bytes behind it.
+	// DirectoryFileDescriptor is only used by queries that look at metadata
+	b32 KeepEntry = 1;
+
+	// NOTE(Felix): We don't want "." and ".." directory links
+	if ((EntryName[0] == '.' && EntryName[1] == 0)  ||
+	    (EntryName[0] == '.' && EntryName[1] == '.' && EntryName[2] == 0))
+	{
+		KeepEntry = 0;
+	}
+
+	// NOTE(Felix): Hidden items (any entry starting with ".")
+	if (FilterHiddenEntries && (EntryName[0] == '.'))
+	{ 
+		KeepEntry = 0;
+	}
+
+	// NOTE(Felix): Apply check if entry contains search string
+	if (SearchFilter)
+	{
+		if (0 == NameFilterMatch(SearchFilter, EntryName, EntryNameLength))
+		{
+			KeepEntry = 0;
+		}
+	}
+
+	// NOTE(Felix): The rest of a query, metadata is only fetched if everything else passed
+	if (KeepEntry && SearchFilter && SearchFilter->Mode == FILTER_MODE_QUERY)
+	{
+		metadata_query *Query = &SearchFilter->Query;
+		entry_stat Stat = { 0 };
+		KeepEntry = QueryMatchEntry(Query, IsDirectory) &&
+		            (0 == QueryNeedsStat(Query) ||
+		             (EntryStatFetch(&Stat, DirectoryFileDescriptor, EntryName) && QueryMatchStat(Query, IsDirectory, &Stat)));
+	}
+
+	return (KeepEntry);
+}
+
+internal i32
+DirectoryGetFirstFileEntryIndex(directory_listing *Listing)
+{
+	directory_view *View = &Listing->View;
+	i32 ResultIndex = 0;
+	for (; 
+	     (ResultIndex < (i32)View->Count) && (Listing->Type[View->Entries[ResultIndex]] != ENTRY_TYPE_FILE); 
+	     ++ResultIndex) 
+	{ 
+		// noop;
+	}
+	return (ResultIndex);
+}
+
+internal void
+SortDirectoryEntries(directory_listing *Listing)
+{
+	u32 Count = Listing->Count;
+	if (Count < 2)
+	{
+		return;
+	}
+
+	// NOTE(Felix): Sort an index list with one combined comparator (directories first, 
+	// then by name) and afterwards move every entry into its final slot once.
+	// [Indices | Sort scratch | Scratch for applying the order, 8 bytes per entry]
+	u64 IndexBufferSize = 4*sizeof(u32)*(u64)Count;
+	u32 *IndexBuffer = mmap(0, IndexBufferSize, PROT_READ|PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	Assert(IndexBuffer != MAP_FAILED);
+
+	u32 *Indices = IndexBuffer;
+	for (u32 Index = 0; Index < Count; ++Index)
+	{
+		Indices[Index] = Index;
+	}
+	u32 *Order = 0;
+	u32 ThreadCount = SortThreadCountGet(Count);
+	if (ThreadCount > 1)
+	{
+		Order = IndexListSortParallel(Indices, IndexBuffer+Count, Count, ThreadCount, Listing);
+	}
+	else
+	{
+		Order = IndexListSort(Indices, IndexBuffer+Count, Count, Listing);
+	}
+	DirectoryListingApplyOrder(Listing, Order, IndexBuffer + 2*Count);
+
+	munmap(IndexBuffer, IndexBufferSize);
+}
+
+internal void
+SortDirectoryEntriesTail(directory_listing *Listing)
+{
+	// NOTE(Felix): Takes every loaded entry into the listing. The first Count entries are 
+	// already in order, only the rest gets sorted, then both runs are merged (stable, so 
+	// the result is the same as sorting everything at once)
+	u32 SortedCount = Listing->Count;
+	u32 Count = Listing->LoadedCount;
+	u32 TailCount = Count - SortedCount;
+	Listing->Count = Count;
+	if (SortedCount == 0)
+	{
+		SortDirectoryEntries(Listing);
+		return;
+	}
+	if (TailCount == 0)
+	{
+		return;
+	}
+
+	// NOTE(Felix): [Merged order | Sorted part, Tail | Scratch], applying the order reuses the
+	// last two as its 8 bytes per entry of scratch
+	u64 IndexBufferSize = 3*sizeof(u32)*(u64)Count;
+	u32 *IndexBuffer = mmap(0, IndexBufferSize, PROT_READ|PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	Assert(IndexBuffer != MAP_FAILED);
+	u32 *Order = IndexBuffer;
+	u32 *Sorted = IndexBuffer + Count;
+	u32 *Tail = Sorted + SortedCount;
+	u32 *Scratch = IndexBuffer + 2*Count;
+
+	for (u32 Index = 0; Index < Count; ++Index)
+	{
+		Sorted[Index] = Index;
+	}
+
+	u32 ThreadCount = SortThreadCountGet(TailCount);
+	if (ThreadCount > 1)
+	{
+		Tail = IndexListSortParallel(Tail, Scratch, TailCount, ThreadCount, Listing);
+	}
+	else
+	{
+		Tail = IndexListSort(Tail, Scratch, TailCount, Listing);
+	}
+	IndexListMerge(Order, Sorted, SortedCount, Tail, TailCount, Listing);
+	DirectoryListingApplyOrder(Listing, Order, IndexBuffer + Count);
+
+	munmap(IndexBuffer, IndexBufferSize);
+}
+
+// NOTE(Felix): Directory reading
+// Instead of going through readdir (one call per entry, backed by a small libc buffer) we
+// call getdents64 ourselves with a big buffer and parse the records in place, so even huge
+// directories only take a handful of syscalls. 
+#define DIRECTORY_READ_BUFFER_SIZE MEBIBYTES(1)
+
+// NOTE(Felix): Names are matched right inside the buffer, see STRING_MATCH_READ_PADDING
+#define DIRECTORY_READ_BUFFER_MAPPED_SIZE (DIRECTORY_READ_BUFFER_SIZE + STRING_MATCH_READ_PADDING)
+
+internal b32
+DirectoryReaderOpen(directory_reader *Reader, char *DirectoryPath)
+{
+	MemoryClear(Reader, sizeof(*Reader));
+	Reader->FileDescriptor = open(DirectoryPath, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (Reader->FileDescriptor < 0)
+	{
+		return (0);
+	}
+
+	Reader->Buffer = mmap(0, DIRECTORY_READ_BUFFER_MAPPED_SIZE, PROT_READ|PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (Reader->Buffer == MAP_FAILED)
+	{
+		close(Reader->FileDescriptor);
+		Reader->FileDescriptor = -1;
+		Reader->Buffer = 0;
+		return (0);
+	}
+	return (1);
+}
+
+internal void
+DirectoryReaderClose(directory_reader *Reader)
+{
+	// NOTE(Felix): Buffer is only set while the reader is open, so this is fine to call
+	// on a reader that never got opened
+	if (Reader->Buffer)
+	{
+		close(Reader->FileDescriptor);
+		munmap(Reader->Buffer, DIRECTORY_READ_BUFFER_MAPPED_SIZE);
+	}
+	MemoryClear(Reader, sizeof(*Reader));
+	Reader->FileDescriptor = -1;
+}
+
+internal b32
+DirectoryReaderFill(directory_reader *Reader)
+{
+	// NOTE(Felix): One getdents64 call, returns 0 once the directory is exhausted (or reading failed)
+	long BytesRead = syscall(SYS_getdents64, Reader->FileDescriptor, Reader->Buffer, DIRECTORY_READ_BUFFER_SIZE);
+	Reader->BufferPosition = 0;
+	Reader->BufferFilled = (BytesRead > 0) ? (u64)BytesRead : 0;
+	return (BytesRead > 0);
+}
+
+internal linux_dirent64 *
+DirectoryReaderNext(directory_reader *Reader)
+{
+	// NOTE(Felix): Returns the next record of the current buffer, 0 once it is used up
+	linux_dirent64 *Record = 0;
+	if (Reader->BufferPosition < Reader->BufferFilled)
+	{
+		Record = (linux_dirent64 *)(void *)(Reader->Buffer + Reader->BufferPosition);
+		Reader->BufferPosition += Record->RecordLength;
+	}
+	return (Record);
+}
+
+internal u64
+TimeGetMilliseconds(void)
+{
+	struct timespec Time = { 0 };
+	clock_gettime(CLOCK_MONOTONIC, &Time);
+	return ((u64)Time.tv_sec*1000 + (u64)Time.tv_nsec/1000000);
+}
+
+// NOTE(Felix): Progressive loading
+// A directory is read one getdents64 buffer at a time, so the UI can draw (and take input)
+// in between. New entries are appended unsorted and every now and then sorted and merged 
+// into the already sorted front part. We merge as soon as the unsorted tail is as big as 
+// the sorted part (so the first chunk shows up right away and the total merge work stays 
+// linear) or when the last update is too long ago.
+#define DIRECTORY_LOAD_UPDATE_INTERVAL_MS 100
+
+// NOTE(Felix): Loading is only handed over to the main loop if the directory takes longer than
+// this, so small directories show up fully loaded without flashing the loading indicator
+#define DIRECTORY_LOAD_FIRST_PAINT_MS 16
+
+internal void
+DirectoryLoadFinish(directory_listing *Listing)
+{
+	DirectoryReaderClose(&Listing->Reader);
+	Listing->IsLoading = 0;
+	DirectoryListingTrim(Listing);
+}
+
+internal void
+DirectoryLoadReadChunk(directory_listing *Listing)
+{
+	// NOTE(Felix): Appends the entries of one buffer worth of records and finishes
+	// the load once the directory is exhausted. Everything is kept, filtering happens in the view
+	if (0 == DirectoryReaderFill(&Listing->Reader))
+	{
+		DirectoryLoadFinish(Listing);
+		return;
+	}
+
+	linux_dirent64 *DirectoryEntry = 0;
+	while ((DirectoryEntry = DirectoryReaderNext(&Listing->Reader)) != 0)
+	{
+		// NOTE(Felix): We only want regular files and directories for now
+		if ((DirectoryEntry->Type == DT_DIR) || (DirectoryEntry->Type == DT_REG)) 
+		{
+			u32 NameLength = StringLength(DirectoryEntry->Name);
+			if (FilterKeepEntry(DirectoryEntry->Name, NameLength, 0, 0, 0, -1))
+			{
+				entry_type Type = (DirectoryEntry->Type == DT_DIR) ? ENTRY_TYPE_DIRECTORY : ENTRY_TYPE_FILE;
+				if (0 == DirectoryListingPush(Listing, DirectoryEntry->Name, NameLength, Type))
+				{
+					// NOTE(Felix): Out of memory, what fit is shown and the status line says so
+					Listing->IsTruncated = 1;
+					DirectoryLoadFinish(Listing);
+					return;
+				}
+			}
+		}
+	}
+}
+
+internal b32
+DirectoryLoadStep(directory_listing *Listing, i32 *SelectedIndex)
+{
+	// NOTE(Felix): Reads one chunk. Returns 1 if the sorted part changed (and thus needs 
+	// to be redrawn). SelectedIndex is kept on the same entry.
+	if (0 == Listing->IsLoading)
+	{
+		return (0);
+	}
+
+	DirectoryLoadReadChunk(Listing);
+
+	u32 UnsortedCount = Listing->LoadedCount - Listing->Count;
+	u64 Now = TimeGetMilliseconds();
+	b32 UpdateSortedPart = ((0 == Listing->IsLoading) ||
+	                        (UnsortedCount >= Listing->Count) ||
+	                        (Now - Listing->LastSortTime >= DIRECTORY_LOAD_UPDATE_INTERVAL_MS));
+	if (UpdateSortedPart && UnsortedCount > 0)
+	{
+		// NOTE(Felix): Names never move, so the name offset identifies the selected entry.
+		// As long as the first entry is selected we just stay at the top
+		directory_view *View = &Listing->View;
+		b32 HasSelection = (*SelectedIndex > 0 && (u32)*SelectedIndex < View->Count);
+		u32 SelectedNameOffset = HasSelection ? Listing->NameOffset[View->Entries[*SelectedIndex]] : 0;
+
+		SortDirectoryEntriesTail(Listing);
+		DirectoryViewRebuild(Listing);
+		Listing->LastSortTime = Now;
+
+		if (HasSelection)
+		{
+			for (u32 Row = 0; Row < View->Count; ++Row)
+			{
+				if (Listing->NameOffset[View->Entries[Row]] == SelectedNameOffset)
+				{
+					*SelectedIndex = (i32)Row;
+					break;
+				}
+			}
+		}
+		return (1);
+	}
+
+	// NOTE(Felix): Finishing changes what is drawn (loading indicator) as well
+	return (0 == Listing->IsLoading);
+}
+
+internal b32
+DirectoryViewQueryStatsUpdate(directory_listing *Listing, i32 *SelectedIndex)
+{
+	// NOTE(Felix): Filters the top level again once metadata a query waited for came in. Right
+	// away if no batch is fetching for it anymore, otherwise every DIRECTORY_LOAD_UPDATE_INTERVAL_MS.
+	// Returns 1 if the view changed, SelectedIndex is kept on the same entry
+	directory_view *View = &Listing->View;
+	if (0 == View->WantedStatsArrived || 0 == DirectoryViewIsComplete(Listing))
+	{
+		return (0);
+	}
+	b32 IsFetching = 0;
+	for (u32 BatchIndex = 0; BatchIndex < STAT_BATCH_COUNT; ++BatchIndex)
+	{
+		stat_batch *Batch = &GLOBALStatBatches[BatchIndex];
+		IsFetching = IsFetching || (Batch->IsBusy && Batch->IsForQuery && Batch->Listing == Listing);
+	}
+	u64 Now = TimeGetMilliseconds();
+	if (IsFetching && Now - View->LastQueryUpdateTime < DIRECTORY_LOAD_UPDATE_INTERVAL_MS)
+	{
+		return (0);
+	}
+	View->WantedStatsArrived = 0;
+	View->LastQueryUpdateTime = Now;
+	if (View->FilterMode != FILTER_MODE_QUERY || 0 == View->MissingStatCount)
+	{
+		return (0);
+	}
+
+	// NOTE(Felix): Entries only ever get added, nothing the query matched before can stop
+	// matching. The pass has no metadata to fetch, so it isn't cancelled on input
+	b32 HasSelection = (*SelectedIndex > 0 && (u32)*SelectedIndex < View->Count);
+	u32 SelectedEntry = HasSelection ? View->Entries[*SelectedIndex] : 0;
+	View->BuiltLevelCount = MIN(View->BuiltLevelCount, View->FilterLength);
+	DirectoryViewFinish(Listing, 0);
+	if (HasSelection)
+	{
+		*SelectedIndex = MAX(DirectoryViewRowFromEntry(Listing, SelectedEntry), 0);
+	}
+	return (1);
+}
+
+// NOTE(Felix): Streaming
+// For directories too big to be held in memory at all. Nothing gets sorted and we only keep
+// a window of entries around the selection. While reading we remember checkpoints (the
+// directory offset of every CheckpointInterval-th entry), so moving the window means seeking
+// to the closest checkpoint and reading forward from there. The checkpoint table has a fixed
+// size, once it is full every second checkpoint is dropped and the interval doubles. That way
+// memory use stays the same no matter how big the directory is.
+#define DIRECTORY_STREAM_WINDOW_SIZE 4096
+#define DIRECTORY_STREAM_WINDOW_MARGIN 1024
+#define DIRECTORY_STREAM_MAX_CHECKPOINTS 4096
+#define DIRECTORY_STREAM_MIN_CHECKPOINT_INTERVAL 256
+
+internal void
+DirectoryStreamCheckpointAdd(directory_stream *Stream, u32 EntryIndex, i64 Cookie)
+{
+	// NOTE(Felix): Checkpoints are only ever added past the last one
+	u32 LastEntryIndex = Stream->Checkpoints[Stream->CheckpointCount-1].EntryIndex;
+	if (EntryIndex <= LastEntryIndex || (EntryIndex % Stream->CheckpointInterval) != 0)
+	{
+		return;
+	}
+
+	if (Stream->CheckpointCount == DIRECTORY_STREAM_MAX_CHECKPOINTS)
+	{
+		Stream->CheckpointInterval *= 2;
+		u32 KeptCount = 0;
+		for (u32 Index = 0; Index < Stream->CheckpointCount; ++Index)
+		{
+			if ((Stream->Checkpoints[Index].EntryIndex % Stream->CheckpointInterval) == 0)
+			{
+				Stream->Checkpoints[KeptCount++] = Stream->Checkpoints[Index];
+			}
+		}
+		Stream->CheckpointCount = KeptCount;
+
+		if ((EntryIndex % Stream->CheckpointInterval) != 0)
+		{
+			return;
+		}
+	}
+
+	directory_stream_checkpoint *Checkpoint = &Stream->Checkpoints[Stream->CheckpointCount++];
+	Checkpoint->EntryIndex = EntryIndex;
+	Checkpoint->Cookie = Cookie;
+}
+
+internal void
+DirectoryStreamRead(directory_listing *Listing, u32 FirstIndex, u32 MaxEntriesToStore)
+{
+	// NOTE(Felix): Seeks to the closest checkpoint before FirstIndex and reads forward, storing
+	// up to MaxEntriesToStore entries starting at FirstIndex into the (cleared) listing.
+	// Checkpoints and the known entry count get updated along the way
+	directory_stream *Stream = &Listing->Stream;
+	directory_stream_checkpoint Start = Stream->Checkpoints[0];
+	for (u32 Index = 1; 
+	     Index < Stream->CheckpointCount && Stream->Checkpoints[Index].EntryIndex <= FirstIndex;
+	     ++Index)
+	{
+		Start = Stream->Checkpoints[Index];
+	}
+
+	DirectoryListingClear(Listing);
+	Stream->WindowStart = FirstIndex;
+	if (0 == Listing->Reader.Buffer ||
+	    lseek(Listing->Reader.FileDescriptor, Start.Cookie, SEEK_SET) < 0)
+	{
+		return;
+	}
+
+	u32 EntryIndex = Start.EntryIndex;
+	i64 Cookie = Start.Cookie;
+	b32 WindowFull = 0;
+	while (0 == WindowFull)
+	{
+		if (0 == DirectoryReaderFill(&Listing->Reader))
+		{
+			Stream->ReachedEnd = 1;
+			Stream->KnownCount = EntryIndex;
+			break;
+		}
+
+		linux_dirent64 *DirectoryEntry = 0;
+		while ((DirectoryEntry = DirectoryReaderNext(&Listing->Reader)) != 0)
+		{
+			i64 CookieBeforeEntry = Cookie;
+			Cookie = DirectoryEntry->Offset;
+
+			// NOTE(Felix): We only want regular files and directories for now
+			u32 NameLength = StringLength(DirectoryEntry->Name);
+			if (((DirectoryEntry->Type != DT_DIR) && (DirectoryEntry->Type != DT_REG)) ||
+			    0 == FilterKeepEntry(DirectoryEntry->Name, NameLength, Stream->FilterHiddenEntries, &Stream->Filter,
+			                         DirectoryEntry->Type == DT_DIR, Listing->DirectoryFileDescriptor))
+			{
+				continue;
+			}
+
+			DirectoryStreamCheckpointAdd(Stream, EntryIndex, CookieBeforeEntry);
+			Stream->KnownCount = MAX(Stream->KnownCount, EntryIndex+1);
+			if (EntryIndex >= FirstIndex)
+			{
+				entry_type Type = (DirectoryEntry->Type == DT_DIR) ? ENTRY_TYPE_DIRECTORY : ENTRY_TYPE_FILE;
+				if (Listing->LoadedCount == MaxEntriesToStore ||
+				    0 == DirectoryListingPush(Listing, DirectoryEntry->Name, NameLength, Type))
+				{
+					WindowFull = 1;
+					break;
+				}
+			}
+			++EntryIndex;
+		}
+	}
+	Listing->Count = Listing->LoadedCount;
+	DirectoryViewRebuild(Listing);
+}
+
+internal void
+DirectoryStreamFillWindow(directory_listing *Listing, u32 FirstIndex)
+{
+	directory_stream *Stream = &Listing->Stream;
+	if (Stream->ReachedEnd)
+	{
+		u32 LastWindowStart = (Stream->KnownCount > DIRECTORY_STREAM_WINDOW_SIZE) ? 
+			Stream->KnownCount - DIRECTORY_STREAM_WINDOW_SIZE : 0;
+		FirstIndex = MIN(FirstIndex, LastWindowStart);
+	}
+	DirectoryStreamRead(Listing, FirstIndex, DIRECTORY_STREAM_WINDOW_SIZE);
+}
+
+internal void
+DirectoryStreamBegin(directory_listing *Listing, char *DirectoryPath, b32 FilterHiddenEntries,
+                     char *FilterBuffer, b32 FilterIsCaseSensitive, filter_mode FilterMode)
+{
+	// NOTE(Felix): A window can't be ranked, so fuzzy search only filters here
+	directory_stream *Stream = &Listing->Stream;
+	DirectoryReaderClose(&Listing->Reader);
+	Listing->IsLoading = 0;
+
+	if (0 == Stream->Checkpoints)
+	{
+		Stream->Checkpoints = mmap(0, DIRECTORY_STREAM_MAX_CHECKPOINTS*sizeof(directory_stream_checkpoint), 
+		                           PROT_READ|PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		Assert(Stream->Checkpoints != MAP_FAILED);
+	}
+	Stream->Checkpoints[0].EntryIndex = 0;
+	Stream->Checkpoints[0].Cookie = 0;
+	Stream->CheckpointCount = 1;
+	Stream->CheckpointInterval = DIRECTORY_STREAM_MIN_CHECKPOINT_INTERVAL;
+	Stream->WindowStart = 0;
+	Stream->KnownCount = 0;
+	Stream->ReachedEnd = 0;
+
+	Stream->FilterHiddenEntries = FilterHiddenEntries;
+	NameFilterInit(&Stream->Filter, FilterMode, FilterBuffer ? FilterBuffer : "", FilterIsCaseSensitive);
+
+	if (0 == DirectoryReaderOpen(&Listing->Reader, DirectoryPath))
+	{
+		DirectoryListingClear(Listing);
+		DirectoryViewRebuild(Listing);
+		Stream->ReachedEnd = 1;
+		return;
+	}
+	DirectoryStreamFillWindow(Listing, 0);
+	DirectoryListingTrim(Listing);
+}
+
+internal void
+DirectoryStreamFollowSelection(directory_listing *Listing, i32 *SelectedIndex, i32 *StartDrawIndex)
+{
+	// NOTE(Felix): SelectedIndex and StartDrawIndex are relative to the window. Once the
+	// selection gets close to either end of the window (and there's more in that direction),
+	// the window gets moved so the selection ends up in its middle
+	if (0 == Listing->IsStreamed)
+	{
+		return;
+	}
+
+	directory_stream *Stream = &Listing->Stream;
+	u32 WindowEnd = Stream->WindowStart + Listing->Count;
+	b32 NearStart = (*SelectedIndex < DIRECTORY_STREAM_WINDOW_MARGIN) && (Stream->WindowStart > 0);
+	b32 NearEnd = (*SelectedIndex + DIRECTORY_STREAM_WINDOW_MARGIN >= (i32)Listing->Count) && (WindowEnd < Stream->KnownCount);
+	if (NearStart || NearEnd)
+	{
+		u32 OldWindowStart = Stream->WindowStart;
+		u32 Selected = OldWindowStart + (u32)MAX(0, *SelectedIndex);
+		u32 NewWindowStart = (Selected > DIRECTORY_STREAM_WINDOW_SIZE/2) ? Selected - DIRECTORY_STREAM_WINDOW_SIZE/2 : 0;
+		DirectoryStreamFillWindow(Listing, NewWindowStart);
+
+		i32 Shift = (i32)OldWindowStart - (i32)Stream->WindowStart;
+		*SelectedIndex = CLAMP(0, *SelectedIndex + Shift, MAX(0, (i32)Listing->Count-1));
+		*StartDrawIndex = MAX(0, *StartDrawIndex + Shift);
+	}
+}
+
+internal void
+DirectoryStreamJumpToEnd(directory_listing *Listing)
+{
+	// NOTE(Felix): Reads (without storing anything) up to the end of the directory
+	// from the last checkpoint, then fills the window with the last entries
+	if (0 == Listing->Stream.ReachedEnd)
+	{
+		DirectoryStreamRead(Listing, (u32)-1, 0);
+	}
+	DirectoryStreamFillWindow(Listing, Listing->Stream.KnownCount);
+}
+
+internal void
+DirectoryListingFree(directory_listing *Listing)
+{
+	DirectoryReaderClose(&Listing->Reader);
+	if (Listing->Stream.Checkpoints)
+	{
+		munmap(Listing->Stream.Checkpoints, DIRECTORY_STREAM_MAX_CHECKPOINTS*sizeof(directory_stream_checkpoint));
+	}
+	DirectoryListingArenasRelease(Listing);
+	NameFilterRelease(&Listing->Stream.Filter);
+	if (Listing->DirectoryFileDescriptor >= 0)
+	{
+		close(Listing->DirectoryFileDescriptor);
+	}
+	// NOTE(Felix): 0 is stdin, a freed listing has no directory open (freeing it again is fine)
+	MemoryClear(Listing, sizeof(*Listing));
+	Listing->DirectoryFileDescriptor = -1;
+}
+
+internal void
+DirectoryLoadBegin(directory_listing *Listing, char *DirectoryPath, i32 *SelectedIndex, 
+                   b32 FilterHiddenEntries, char *FilterBuffer, b32 FilterIsCaseSensitive)
+{
+	// NOTE(Felix): Starts a progressive load and reads the first chunk(s) right away, 
+	// the rest is read by calling DirectoryLoadStep. The filter is applied to the view
+	// (in whatever mode the view is in already)
+	*SelectedIndex = 0;
+	filter_mode FilterMode = Listing->View.FilterMode;
+	DirectoryViewSetFilter(Listing, FilterHiddenEntries, FilterBuffer, FilterIsCaseSensitive, FilterMode, 0);
+	DirectoryListingOpenDirectory(Listing, DirectoryPath);
+	if (Listing->IsStreamed)
+	{
+		DirectoryStreamBegin(Listing, DirectoryPath, FilterHiddenEntries, FilterBuffer, FilterIsCaseSensitive, FilterMode);
+		return;
+	}
+
+	DirectoryReaderClose(&Listing->Reader);
+	Listing->IsLoading = 0;
+	DirectoryListingClear(Listing);
+	DirectoryViewRebuild(Listing);
+
+	if (DirectoryReaderOpen(&Listing->Reader, DirectoryPath))
+	{
+		u64 StartTime = TimeGetMilliseconds();
+		Listing->IsLoading = 1;
+		Listing->LastSortTime = StartTime;
+		do
+		{
+			DirectoryLoadStep(Listing, SelectedIndex);
+		} while (Listing->IsLoading && 
+		         TimeGetMilliseconds() - StartTime < DIRECTORY_LOAD_FIRST_PAINT_MS);
+	}
+}
+
+internal u64
+DirectoryListingMemorySize(directory_listing *Listing)
+{
+	return (Listing->NamesArena.Committed + Listing->NameOffsetArena.Committed +
+	        Listing->NameLengthArena.Committed + Listing->TypeArena.Committed +
+	        Listing->FlagsArena.Committed + Listing->SortKeyArena.Committed +
+	        Listing->CharMaskArena.Committed + Listing->SizeArena.Committed +
+	        Listing->ModifiedTimeArena.Committed + Listing->ModeArena.Committed +
+	        Listing->OwnerArena.Committed + Listing->View.LevelArena.Committed);
+}
+
+internal void
+DirectoryCacheEvict(directory_cache *Cache, directory_cache_entry *Entry)
+{
+	Cache->MemorySize -= Entry->MemorySize;
+	DirectoryListingFree(&Entry->Listing);
+	Entry->IsUsed = 0;
+}
+
+internal b32
+DirectoryCacheEvictOldest(directory_cache *Cache)
+{
+	// NOTE(Felix): Returns 0 if the cache is empty
+	directory_cache_entry *Oldest = 0;
+	for (u32 EntryIndex = 0; EntryIndex < DIRECTORY_CACHE_MAX_LISTINGS; ++EntryIndex)
+	{
+		directory_cache_entry *Entry = &Cache->Entries[EntryIndex];
+		if (Entry->IsUsed && (0 == Oldest || Entry->LastUsed < Oldest->LastUsed))
+		{
+			Oldest = Entry;
+		}
+	}
+	if (Oldest)
+	{
+		DirectoryCacheEvict(Cache, Oldest);
+	}
+	return (Oldest != 0);
+}
+
+internal b32
+DirectoryCacheStore(directory_cache *Cache, directory_listing *Listing, i32 SelectedIndex, i32 StartDrawIndex,
+                    b32 IsPrefetched)
+{
+	// NOTE(Felix): Moves Listing into the cache if it can be cached and returns 1. Listing is
+	// left without any memory then (only its filter mode is kept), it has to be allocated
+	// again before it can hold entries. The selection and scroll position are kept with it.
+	// A prefetched listing replaces the one prefetched before, if that is still there, but
+	// never the listing of a directory we were in (that one keeps the view we left it with)
+	u64 MemorySize = DirectoryListingMemorySize(Listing);
+	if (Listing->IsStreamed || Listing->IsLoading || 0 == Listing->IdentityIsValid ||
+	    MemorySize > DIRECTORY_CACHE_MAX_MEMORY)
+	{
+		return (0);
+	}
+	for (u32 EntryIndex = 0; IsPrefetched && EntryIndex < DIRECTORY_CACHE_MAX_LISTINGS; ++EntryIndex)
+	{
+		directory_cache_entry *Entry = &Cache->Entries[EntryIndex];
+		if (Entry->IsUsed && 0 == Entry->IsPrefetched &&
+		    Entry->Listing.Identity.Device == Listing->Identity.Device &&
+		    Entry->Listing.Identity.Inode == Listing->Identity.Inode)
+		{
+			return (0);
+		}
+	}
+
+	u32 UsedCount = 0;
+	for (u32 EntryIndex = 0; EntryIndex < DIRECTORY_CACHE_MAX_LISTINGS; ++EntryIndex)
+	{
+		directory_cache_entry *Entry = &Cache->Entries[EntryIndex];
+		if (Entry->IsUsed &&
+		    ((IsPrefetched && Entry->IsPrefetched) ||
+		     (Entry->Listing.Identity.Device == Listing->Identity.Device &&
+		      Entry->Listing.Identity.Inode == Listing->Identity.Inode)))
+		{
+			DirectoryCacheEvict(Cache, Entry);
+		}
+		UsedCount += (Entry->IsUsed != 0);
+	}
+
+	while (UsedCount == DIRECTORY_CACHE_MAX_LISTINGS ||
+	       Cache->MemorySize + MemorySize > DIRECTORY_CACHE_MAX_MEMORY)
+	{
+		DirectoryCacheEvictOldest(Cache);
+		--UsedCount;
+	}
+
+	for (u32 EntryIndex = 0; EntryIndex < DIRECTORY_CACHE_MAX_LISTINGS; ++EntryIndex)
+	{
+		directory_cache_entry *Entry = &Cache->Entries[EntryIndex];
+		if (0 == Entry->IsUsed)
+		{
+			Entry->IsUsed = 1;
+			Entry->LastUsed = ++Cache->UseCounter;
+			Entry->MemorySize = MemorySize;
+			Entry->SelectedIndex = SelectedIndex;
+			Entry->StartDrawIndex = StartDrawIndex;
+			Entry->IsPrefetched = IsPrefetched;
+			Entry->Listing = *Listing;
+			Cache->MemorySize += MemorySize;
+			break;
+		}
+	}
+
+	filter_mode FilterMode = Listing->View.FilterMode;
+	MemoryClear(Listing, sizeof(*Listing));
+	Listing->DirectoryFileDescriptor = -1;
+	Listing->View.FilterMode = FilterMode;
+	return (1);
+}
+
+internal b32
+DirectoryCacheTake(directory_cache *Cache, directory_listing *Listing, char *DirectoryPath,
+                   i32 *SelectedIndex, i32 *StartDrawIndex)
+{
+	// NOTE(Felix): Replaces Listing with the cached listing of DirectoryPath if there is one
+	// that is still up to date, view and all, and hands back where it was left. Returns 0 if
+	// there isn't
+	if (Listing->IsStreamed)
+	{
+		return (0);
+	}
+
+	directory_identity Identity = { 0 };
+	i32 DirectoryFileDescriptor = open(DirectoryPath, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	b32 IdentityIsValid = (DirectoryFileDescriptor >= 0 && DirectoryIdentityGet(DirectoryFileDescriptor, &Identity));
+	directory_cache_entry *Found = 0;
+	for (u32 EntryIndex = 0; IdentityIsValid && EntryIndex < DIRECTORY_CACHE_MAX_LISTINGS; ++EntryIndex)
+	{
+		directory_cache_entry *Entry = &Cache->Entries[EntryIndex];
+		if (Entry->IsUsed &&
+		    Entry->Listing.Identity.Device == Identity.Device &&
+		    Entry->Listing.Identity.Inode == Identity.Inode)
+		{
+			Found = Entry;
+			break;
+		}
+	}
+
+	if (Found &&
+	    (Found->Listing.Identity.ModifiedTime != Identity.ModifiedTime ||
+	     Found->Listing.Identity.ChangeTime != Identity.ChangeTime))
+	{
+		DirectoryCacheEvict(Cache, Found);
+		Found = 0;
+	}
+	if (0 == Found)
+	{
+		if (DirectoryFileDescriptor >= 0)
+		{
+			close(DirectoryFileDescriptor);
+		}
+		++Cache->MissCount;
+		return (0);
+	}
+
+	DirectoryListingFree(Listing);
+	*Listing = Found->Listing;
+	*SelectedIndex = Found->SelectedIndex;
+	*StartDrawIndex = Found->StartDrawIndex;
+	Found->IsUsed = 0;
+	Cache->MemorySize -= Found->MemorySize;
+	++Cache->HitCount;
+
+	// NOTE(Felix): Same directory, but opened anew. Metadata may have changed without the
+	// directory changing, so that gets fetched again
+	close(Listing->DirectoryFileDescriptor);
+	Listing->DirectoryFileDescriptor = DirectoryFileDescriptor;
+	Listing->Generation = DirectoryListingGenerationNext();
+	for (u32 EntryIndex = 0; EntryIndex < Listing->Count; ++EntryIndex)
+	{
+		Listing->Flags[EntryIndex] &= (u8)~(ENTRY_FLAG_STAT_CACHED | ENTRY_FLAG_STAT_FAILED | ENTRY_FLAG_STAT_PENDING);
+	}
+	return (1);
+}
+
+internal b32
+DirectoryChange(directory_listing *Listing, char *DirectoryPath, i32 *SelectedIndex, i32 *StartDrawIndex,
+                b32 FilterHiddenEntries, char *FilterBuffer, u32 *FilterBufferIndex, b32 FilterIsCaseSensitive)
+{
+	// NOTE(Felix): Like DirectoryLoadBegin, but the listing we leave goes into the cache and
+	// the one we go to comes out of it if it's still up to date. That one is shown the way we
+	// left it: same filter (copied into FilterBuffer), selection and scroll position, only
+	// hidden entries follow the current setting. Returns 1 if the listing came from the cache
+	directory_cache *Cache = &GLOBALDirectoryCache;
+	b32 WasStored = DirectoryCacheStore(Cache, Listing, *SelectedIndex, *StartDrawIndex, 0);
+	if (DirectoryCacheTake(Cache, Listing, DirectoryPath, SelectedIndex, StartDrawIndex))
+	{
+		directory_view *View = &Listing->View;
+		if (View->HideHiddenEntries != FilterHiddenEntries)
+		{
+			i32 SelectedEntry = ((u32)*SelectedIndex < View->Count) ? (i32)View->Entries[*SelectedIndex] : -1;
+			DirectoryViewSetFilter(Listing, FilterHiddenEntries, 
+			                       View->Filter, View->FilterIsCaseSensitive, View->FilterMode, 0);
+			*SelectedIndex = (SelectedEntry >= 0) ? MAX(0, DirectoryViewRowFromEntry(Listing, (u32)SelectedEntry)) : 0;
+		}
+		*SelectedIndex = CLAMP(0, *SelectedIndex, MAX((i32)View->Count-1, 0));
+		StringCopyBounded(FilterBuffer, View->Filter, DIRECTORY_VIEW_MAX_FILTER_LENGTH);
+		*FilterBufferIndex = StringLength(FilterBuffer);
+		return (1);
+	}
+
+	// NOTE(Felix): If there isn't enough address space for another listing, cached ones make room
+	if (WasStored)
+	{
+		filter_mode FilterMode = Listing->View.FilterMode;
+		while (0 == DirectoryListingAllocate(Listing) && DirectoryCacheEvictOldest(Cache));
+		Listing->View.FilterMode = FilterMode;
+	}
+	DirectoryLoadBegin(Listing, DirectoryPath, SelectedIndex, FilterHiddenEntries, FilterBuffer, FilterIsCaseSensitive);
+	return (0);
+}
+
+internal void
+DirectoryPrefetchRun(job *Job)
+{
+	// NOTE(Felix): On a worker. Reads the whole directory, sorts it and builds the (unfiltered)
+	// view, none of which needs anything but the listing itself
+	directory_prefetch *Prefetch = Job->Data;
+	directory_listing *Listing = &Prefetch->Listing;
+	Prefetch->IsReady = 0;
+	if (0 == DirectoryListingAllocate(Listing))
+	{
+		return;
+	}
+	DirectoryListingOpenDirectory(Listing, Prefetch->Path);
+	if (0 == Listing->IdentityIsValid)
+	{
+		return;
+	}
+	for (u32 CachedIndex = 0; CachedIndex < Prefetch->CachedCount; ++CachedIndex)
+	{
+		directory_identity *Cached = &Prefetch->Cached[CachedIndex];
+		if (Cached->Device == Listing->Identity.Device && Cached->Inode == Listing->Identity.Inode &&
+		    Cached->ModifiedTime == Listing->Identity.ModifiedTime && Cached->ChangeTime == Listing->Identity.ChangeTime)
+		{
+			return;
+		}
+	}
+	if (0 == DirectoryReaderOpen(&Listing->Reader, Prefetch->Path))
+	{
+		return;
+	}
+
+	// NOTE(Felix): A listing that is still loading gets freed (reader and all) by its owner
+	Listing->IsLoading = 1;
+	while (Listing->IsLoading)
+	{
+		if (JobIsCancelled(Job) || Listing->LoadedCount > DIRECTORY_PREFETCH_MAX_ENTRIES)
+		{
+			return;
+		}
+		DirectoryLoadReadChunk(Listing);
+	}
+	SortDirectoryEntriesTail(Listing);
+	Listing->View.HideHiddenEntries = Prefetch->HideHiddenEntries;
+	Listing->View.FilterMode = Prefetch->FilterMode;
+	DirectoryViewRebuild(Listing);
+	Prefetch->IsReady = 1;
+}
+
+internal void
+DirectoryPrefetchComplete(job *Job)
+{
+	directory_prefetch *Prefetch = Job->Data;
+	Prefetch->IsBusy = 0;
+	if (Job->WasRun)
+	{
+		// NOTE(Felix): Cancelled means the selection moved on (or we went somewhere) while it
+		// ran, the listing may be outdated by what happened in the meantime
+		if (Prefetch->IsReady && 0 == JobIsCancelled(Job))
+		{
+			DirectoryCacheStore(&GLOBALDirectoryCache, &Prefetch->Listing, 0, 0, 1);
+		}
+		DirectoryListingFree(&Prefetch->Listing);
+	}
+}
+
+internal i32
+DirectoryPrefetchUpdate(directory_prefetch *Prefetch, directory_listing *Listing, i32 SelectedIndex,
+                        char *DirectoryPath, job_system *Jobs)
+{
+	// NOTE(Felix): Call once per frame. Returns in how many milliseconds the selection will
+	// have rested long enough, -1 if there is nothing to wait for
+	directory_view *View = &Listing->View;
+	b32 HasTarget = (0 == Listing->IsStreamed && 0 == Listing->IsLoading && (u32)SelectedIndex < View->Count &&
+	                 Listing->Type[View->Entries[SelectedIndex]] == ENTRY_TYPE_DIRECTORY);
+	u32 EntryIndex = HasTarget ? View->Entries[SelectedIndex] : 0;
+	u64 Now = TimeGetMilliseconds();
+	if (HasTarget != Prefetch->HasTarget || EntryIndex != Prefetch->EntryIndex ||
+	    Listing->Generation != Prefetch->ListingGeneration)
+	{
+		if (Prefetch->IsBusy)
+		{
+			JobCancel(&Prefetch->Job);
+		}
+		Prefetch->HasTarget = HasTarget;
+		Prefetch->ListingGeneration = Listing->Generation;
+		Prefetch->EntryIndex = EntryIndex;
+		Prefetch->TargetSince = Now;
+		Prefetch->WasSubmitted = 0;
+	}
+
+	// NOTE(Felix): A cancelled prefetch wakes us up once it is done, the next one starts then
+	if (0 == HasTarget || Prefetch->WasSubmitted || Prefetch->IsBusy)
+	{
+		return (-1);
+	}
+	if (Now - Prefetch->TargetSince < DIRECTORY_PREFETCH_REST_MS)
+	{
+		return ((i32)(DIRECTORY_PREFETCH_REST_MS - (Now - Prefetch->TargetSince)));
+	}
 
-	// NOTE(Felix): Find end of directory / start of files and sort each sublist by name
-	i32 EntryFilesStartIndex = DirectoryGetFirstFileEntryIndex(Buffer, Count);
-	InternalEntryListSort(Buffer, EntryFilesStartIndex, &InternalEntryCompareName);
-	InternalEntryListSort(Buffer+EntryFilesStartIndex, (i32)Count-EntryFilesStartIndex, &InternalEntryCompareName);
+	directory_cache *Cache = &GLOBALDirectoryCache;
+	snprintf(Prefetch->Path, sizeof(Prefetch->Path), "%s%s", DirectoryPath, DirectoryListingName(Listing, EntryIndex));
+	Prefetch->HideHiddenEntries = View->HideHiddenEntries;
+	Prefetch->FilterMode = View->FilterMode;
+	Prefetch->CachedCount = 0;
+	for (u32 CacheIndex = 0; CacheIndex < DIRECTORY_CACHE_MAX_LISTINGS; ++CacheIndex)
+	{
+		if (Cache->Entries[CacheIndex].IsUsed)
+		{
+			Prefetch->Cached[Prefetch->CachedCount++] = Cache->Entries[CacheIndex].Listing.Identity;
+		}
+	}
+	Prefetch->Job.Run = &DirectoryPrefetchRun;
+	Prefetch->Job.Complete = &DirectoryPrefetchComplete;
+	Prefetch->Job.Data = Prefetch;
+	Prefetch->IsBusy = 1;
+	Prefetch->WasSubmitted = 1;
+	JobSubmit(Jobs, &Prefetch->Job);
+	return (-1);
 }
 
 internal void
-DirectoryReadIntoBufferAndFilter(internal_directory_entry *Buffer, u32 *EntryCount,
-                                 char *DirectoryPath, b32 FilterHiddenEntries,
-                                 char *FilterBuffer, b32 FilterIsCaseSensitive)
+DirectoryFilterUpdate(directory_listing *Listing, i32 *SelectedIndex, char *DirectoryPath, b32 FilterHiddenEntries, 
+                      char *FilterBuffer, b32 FilterIsCaseSensitive, filter_mode FilterMode)
 {
-	// NOTE(Felix): Open directory stream
-	DIR *DirectoryStream = opendir(DirectoryPath);
-
-	// NOTE(Felix): Gather and store all valid entries
-	struct dirent *DirectoryEntry = readdir(DirectoryStream);
-	u32 EntryCountResult = 0;
-	while (DirectoryEntry != 0)
+	// NOTE(Felix): Applies a changed filter without touching the disk. Typing ahead cancels
+	// filtering, the view gets finished later (see DirectoryViewFinish).
+	// Streamed listings only hold a window though, so the stream restarts with the new filter
+	if (Listing->IsStreamed)
 	{
-		// NOTE(Felix): We only want regular files and directories for now
-		if ((DirectoryEntry->d_type == DT_DIR) || (DirectoryEntry->d_type == DT_REG)) 
-		{
-			if (FilterKeepEntry(DirectoryEntry->d_name, FilterHiddenEntries, FilterBuffer, FilterIsCaseSensitive))
-			{
-				internal_directory_entry InternalEntry = CreateInternalEntryFromDirent(DirectoryEntry);
-				Buffer[EntryCountResult] = InternalEntry;
-				EntryCountResult++;
-			}
-		}
-		DirectoryEntry = readdir(DirectoryStream);
+		DirectoryStreamBegin(Listing, DirectoryPath, FilterHiddenEntries, FilterBuffer, FilterIsCaseSensitive, FilterMode);
+		*SelectedIndex = 0;
+		return;
 	}
-	closedir(DirectoryStream);
-
-	SortDirectoryEntries(Buffer, EntryCountResult);
-	*EntryCount = EntryCountResult;
+	DirectoryViewSetFilter(Listing, FilterHiddenEntries, FilterBuffer, FilterIsCaseSensitive, FilterMode, 1);
 }
 
 internal i32
-DirectoryGetIndexFromName(internal_directory_entry *Buffer, u32 EntryCount, char *EntryName)
+DirectoryFindEntry(directory_listing *Listing, char *EntryName)
 {
+	// NOTE(Felix): Returns the row in the view, -1 if there's no entry with that name
 	for (i32 Index = 0;
-	     Index < (i32)EntryCount;
+	     Index < (i32)Listing->View.Count;
 	     ++Index)
 	{
-		if (StringEqual(Buffer[Index].Name, EntryName))
+		if (StringEqual(DirectoryListingName(Listing, Listing->View.Entries[Index]), EntryName))
 		{
 			return (Index);
 		}
 	}
-	return (0);
+	return (-1);
+}
+
+internal i32
+DirectoryGetIndexFromName(directory_listing *Listing, char *EntryName)
+{
+	return (MAX(0, DirectoryFindEntry(Listing, EntryName)));
 }
 
 internal void
@@ -440,11 +2973,100 @@ DirectoryEnter(char *PathBuffer, char *DirectoryName)
 	chdir(PathBuffer);
 }
 
+internal f64
+StatBenchmarkPass(directory_listing *Listing, job_system *Jobs, event_loop *EventLoop)
+{
+	// NOTE(Felix): Fetches the metadata of every entry through the stat batches, the same way 
+	// the long listing does. Returns stats per second
+	for (u32 EntryIndex = 0; EntryIndex < Listing->Count; ++EntryIndex)
+	{
+		Listing->Flags[EntryIndex] &= (u8)~(ENTRY_FLAG_STAT_CACHED | ENTRY_FLAG_STAT_FAILED);
+	}
+
+	u64 StartTime = ConsoleTimeGetNanoseconds();
+	u32 NextEntry = 0;
+	for (;;)
+	{
+		while (NextEntry < Listing->Count)
+		{
+			stat_batch *Batch = StatBatchBegin(Listing, 0, Listing->Count);
+			if (0 == Batch)
+			{
+				break;
+			}
+			for (; NextEntry < Listing->Count && Batch->Count < STAT_BATCH_MAX_ENTRIES; ++NextEntry)
+			{
+				StatBatchAdd(Batch, Listing, NextEntry);
+			}
+			StatBatchSubmit(Jobs, Batch);
+		}
+
+		b32 IsBusy = 0;
+		for (u32 BatchIndex = 0; BatchIndex < STAT_BATCH_COUNT; ++BatchIndex)
+		{
+			IsBusy = IsBusy || GLOBALStatBatches[BatchIndex].IsBusy;
+		}
+		if (0 == IsBusy && NextEntry == Listing->Count)
+		{
+			break;
+		}
+		if (0 == JobSystemDrain(Jobs))
+		{
+			event_loop_events Events = { 0 };
+			EventLoopWait(EventLoop, 100, &Events);
+		}
+	}
+
+	f64 Seconds = (f64)(ConsoleTimeGetNanoseconds() - StartTime) / 1e9;
+	return ((f64)Listing->Count / MAX(Seconds, 1e-9));
+}
+
+internal void
+StatBenchmarkRun(char *DirectoryPath, job_system *Jobs, event_loop *EventLoop)
+{
+	// NOTE(Felix): "--stat-benchmark": how many stats per second each backend manages on the
+	// given directory. One untimed pass first, so both timed ones see the same (warm) caches
+	directory_listing Listing = { 0 };
+	if (0 == DirectoryListingAllocate(&Listing))
+	{
+		fprintf(stderr, "Couldn't reserve memory for the directory listing\n");
+		return;
+	}
+	i32 SelectedIndex = 0;
+	DirectoryLoadBegin(&Listing, DirectoryPath, &SelectedIndex, 0, 0, 0);
+	while (Listing.IsLoading)
+	{
+		DirectoryLoadStep(&Listing, &SelectedIndex);
+	}
+	printf("%s: %" PFu32 " entries\n", DirectoryPath, Listing.Count);
+
+	b32 RingIsDisabled = GLOBALStatRingDisabled;
+	GLOBALStatRingDisabled = 1;
+	StatBenchmarkPass(&Listing, Jobs, EventLoop);
+	f64 SyscallRate = StatBenchmarkPass(&Listing, Jobs, EventLoop);
+	GLOBALStatRingDisabled = RingIsDisabled;
+	f64 RingRate = StatBenchmarkPass(&Listing, Jobs, EventLoop);
+
+	printf("statx:    %10.0f stats/s (%" PFu32 " workers)\n", SyscallRate, Jobs->WorkerCount);
+	if (GLOBALStatRingDisabled)
+	{
+		printf("io_uring: unavailable\n");
+	}
+	else
+	{
+		printf("io_uring: %10.0f stats/s (%" PFu32 " workers, %d requests per submission)\n", 
+		       RingRate, Jobs->WorkerCount, STAT_BATCH_MAX_ENTRIES);
+	}
+	DirectoryListingFree(&Listing);
+}
+
 internal void
 ConsoleSetup(void)
 {
+	// NOTE(Felix): Whatever ran in between may have drawn over us, the next frame repaints everything
 	EchoDisable();
 	CursorHide();
+	ScreenInvalidate(&GLOBALScreen);
 }
 
 internal void
@@ -486,14 +3108,39 @@ UpdateStartDrawIndex(i32 NumberOfEntries, i32 SelectedIndex, i32 ConsoleRows)
 }
 
 internal void
-RefreshCurrentDirectory(internal_directory_entry *EntriesBuffer, u32 *EntryCount, i32 *SelectedIndex, char *DirectoryPath,
-                        b32 FilterHiddenEntries, char *FilterBuffer, b32 FilterIsCaseSensitive)
+DirectoryLoadSelectPending(directory_listing *Listing, i32 *SelectedIndex, char *PendingSelectionName)
+{
+	// NOTE(Felix): Selects the entry named PendingSelectionName as soon as it has been loaded.
+	// Gives up once the directory is fully loaded
+	if (PendingSelectionName[0] != 0)
+	{
+		i32 Index = DirectoryFindEntry(Listing, PendingSelectionName);
+		if (Index >= 0)
+		{
+			*SelectedIndex = Index;
+		}
+		if (Index >= 0 || 0 == Listing->IsLoading)
+		{
+			PendingSelectionName[0] = 0;
+		}
+	}
+}
+
+internal void
+RefreshCurrentDirectory(directory_listing *Listing, i32 *SelectedIndex, char *PendingSelectionName, 
+                        char *DirectoryPath, b32 FilterHiddenEntries, char *FilterBuffer, b32 FilterIsCaseSensitive)
 {
-	// NOTE(Felix): Refresh directory by saving current name, reloading directory and finding the name we saved
-	internal_directory_entry SelectedEntry = EntriesBuffer[*SelectedIndex];
-	DirectoryReadIntoBufferAndFilter(EntriesBuffer, EntryCount, DirectoryPath, 
-	                                 FilterHiddenEntries, FilterBuffer, FilterIsCaseSensitive);
-	*SelectedIndex = DirectoryGetIndexFromName(EntriesBuffer, *EntryCount, SelectedEntry.Name);
+	// NOTE(Felix): Refresh directory by saving current name, reloading directory and selecting 
+	// the name we saved once it shows up again
+	// (the name has to be copied out, reloading overwrites the name buffer)
+	PendingSelectionName[0] = 0;
+	if ((u32)*SelectedIndex < Listing->View.Count)
+	{
+		StringCopy(PendingSelectionName, DirectoryListingName(Listing, Listing->View.Entries[*SelectedIndex]));
+	}
+	DirectoryLoadBegin(Listing, DirectoryPath, SelectedIndex,
+	                   FilterHiddenEntries, FilterBuffer, FilterIsCaseSensitive);
+	DirectoryLoadSelectPending(Listing, SelectedIndex, PendingSelectionName);
 }
 
 internal void
@@ -503,30 +3150,46 @@ ClearFilter(char *FilterBuffer, u32 *FilterBufferIndex)
 	*FilterBufferIndex = 0;
 }
 
+internal b32
+IndexIsOffscreen(i32 SelectedIndex, i32 StartDrawIndex, i32 ConsoleRows)
+{
+	if (SelectedIndex < StartDrawIndex ||
+	    SelectedIndex - StartDrawIndex >= ConsoleRows)
+	{
+		return (1);
+	}
+	else
+	{
+		return (0);
+	}
+}
+
 internal void
-OpenFileOrEnterDirectory(internal_directory_entry *Entry, 
-                         internal_directory_entry *EntriesBuffer, u32 *EntryCount,
+OpenFileOrEnterDirectory(directory_listing *Listing, u32 EntryIndex,
                          i32 *SelectedIndex, i32 *StartDrawIndex, i32 ConsoleRows,
                          char *PathBuffer, b32 FilterHiddenEntries,
                          char *FilterBuffer, u32 *FilterBufferIndex, b32 FilterIsCaseSensitive)
 {
-	switch (Entry->Type)
+	char *EntryName = DirectoryListingName(Listing, EntryIndex);
+	switch (Listing->Type[EntryIndex])
 	{
 		case ENTRY_TYPE_FILE: {
-			if (FileIsExecutable(Entry->Name))
+			if (FileIsExecutable(Listing->DirectoryFileDescriptor, EntryName))
 			{
 				// NOTE(Felix): Append executable to path
 				u32 PathLength = StringLength(PathBuffer);
-				u32 FileLength = StringLength(Entry->Name);
-				MemoryCopy(PathBuffer+PathLength, Entry->Name, FileLength);
+				u32 FileLength = StringLength(EntryName);
+				MemoryCopy(PathBuffer+PathLength, EntryName, FileLength);
 				ConsoleCleanup();
 
 				// NOTE(Felix): Execl replaces current process if successfull
 				// If it fails, we'll simply try open it with something
-				execl(PathBuffer, Entry->Name, 0);
+				EventLoopChildPrepare();
+				execl(PathBuffer, EntryName, 0);
+				EventLoopChildRestore();
 			}
 
-			file_type_config ProgramToUseConfig = GetProgramToUseConfig(Entry->Name);
+			file_type_config ProgramToUseConfig = GetProgramToUseConfig(EntryName);
 			char *ProgramName = GetProgramNameFromFullPath(ProgramToUseConfig.PathToProgram);
 			ConsoleCleanup();
 			pid_t ChildProcessID = fork();
@@ -561,7 +3224,8 @@ OpenFileOrEnterDirectory(internal_directory_entry *Entry,
 						exit(0);
 					}
 				}
-				execl(ProgramToUseConfig.PathToProgram, ProgramName, Entry->Name, 0);
+				EventLoopChildPrepare();
+				execl(ProgramToUseConfig.PathToProgram, ProgramName, EntryName, 0);
 				exit(0); // Exit if execl failes for some reason
 			}
 			else
@@ -577,11 +3241,20 @@ OpenFileOrEnterDirectory(internal_directory_entry *Entry,
 		case ENTRY_TYPE_DIRECTORY: {
 			// Reset filter after entering directory
 			ClearFilter(FilterBuffer, FilterBufferIndex);
-			DirectoryEnter(PathBuffer, Entry->Name);
-			DirectoryReadIntoBufferAndFilter(EntriesBuffer, EntryCount, PathBuffer, 
-			                                 FilterHiddenEntries, FilterBuffer, FilterIsCaseSensitive);
-			*SelectedIndex = 0;
-			*StartDrawIndex = UpdateStartDrawIndex((i32)*EntryCount, *SelectedIndex, ConsoleRows);
+			DirectoryEnter(PathBuffer, EntryName);
+			if (DirectoryChange(Listing, PathBuffer, SelectedIndex, StartDrawIndex,
+			                    FilterHiddenEntries, FilterBuffer, FilterBufferIndex, FilterIsCaseSensitive))
+			{
+				// NOTE(Felix): Back where we were, unless the console got smaller in the meantime
+				if (IndexIsOffscreen(*SelectedIndex, *StartDrawIndex, ConsoleRows-2))
+				{
+					*StartDrawIndex = UpdateStartDrawIndex((i32)Listing->View.Count, *SelectedIndex, ConsoleRows);
+				}
+			}
+			else
+			{
+				*StartDrawIndex = UpdateStartDrawIndex((i32)Listing->View.Count, *SelectedIndex, ConsoleRows);
+			}
 		} break;
 
 		default: {
@@ -614,68 +3287,48 @@ CenterIndexByReturningStartDrawIndex(i32 SelectedIndex, i32 StartDrawIndex,
 	}
 }
 
-internal b32
-IndexIsOffscreen(i32 SelectedIndex, i32 StartDrawIndex, i32 ConsoleRows)
-{
-	if (SelectedIndex < StartDrawIndex ||
-	    SelectedIndex - StartDrawIndex >= ConsoleRows)
-	{
-		return (1);
-	}
-	else
-	{
-		return (0);
-	}
-}
-
 
 internal void
-SearchFilterInputCharacter(internal_directory_entry *EntriesBuffer, u32 *EntryCount, 
+SearchFilterInputCharacter(directory_listing *Listing, 
                            i32 *SelectedIndex, i32 *StartDrawIndex, i32 ConsoleRows,
                            char *DirectoryPath, b32 FilterHiddenEntries,
                            char *FilterBuffer, u32 *FilterBufferIndex, u32 FilterBufferSize,
-                           program_state *ProgramState, i32 InputCharacter, b32 FilterIsCaseSensitive)
+                           program_state *ProgramState, i32 InputCharacter, 
+                           b32 FilterIsCaseSensitive, filter_mode FilterMode)
 {
-	// TODO(Felix): I'm not a fan of how I'm solving this
-	// Whenever we "broaden" up our search, we re-read the whole directory into our buffer
-	// this makes the code easy, but is probably really unperformant on bigger directories
-	// then again I haven't measured stuff so it may be fine I dunno
-
+	// NOTE(Felix): The listing stays as it is, every change of the filter only updates the
+	// view (see DirectoryViewSetFilter), so neither typing nor deleting re-reads the directory
 	switch (InputCharacter)
 	{
 		// NOTE(Felix): Delete last character of filter
-		// We just refill the buffer and reapply the updated filter
 		case 127: // DEL, terminal emulators (at least mine) sends this when pressing backspace
 		case '\b': { 
 			if (*FilterBufferIndex > 0)
 			{
 				*FilterBufferIndex -= 1;
 				FilterBuffer[*FilterBufferIndex] = 0;
-				DirectoryReadIntoBufferAndFilter(EntriesBuffer, EntryCount,
-				                                 DirectoryPath, FilterHiddenEntries,
-				                                 FilterBuffer, FilterIsCaseSensitive);
+				DirectoryFilterUpdate(Listing, SelectedIndex, DirectoryPath, FilterHiddenEntries, 
+				                      FilterBuffer, FilterIsCaseSensitive, FilterMode);
 			}
 		} break;
 
 			// NOTE(Felix): Reset, but don't abort search
 		case 23: { // Control-W
 			ClearFilter(FilterBuffer, FilterBufferIndex);
-			DirectoryReadIntoBufferAndFilter(EntriesBuffer, EntryCount,
-			                                 DirectoryPath, FilterHiddenEntries,
-			                                 0, 0);
+			DirectoryFilterUpdate(Listing, SelectedIndex, DirectoryPath, FilterHiddenEntries, 
+			                      FilterBuffer, FilterIsCaseSensitive, FilterMode);
 		} break;
 
 			// NOTE(Felix): Abort search
 		case 27: { // ESC
 			ClearFilter(FilterBuffer, FilterBufferIndex);
-			DirectoryReadIntoBufferAndFilter(EntriesBuffer, EntryCount,
-			                                 DirectoryPath, FilterHiddenEntries,
-			                                 0, 0);
+			DirectoryFilterUpdate(Listing, SelectedIndex, DirectoryPath, FilterHiddenEntries, 
+			                      FilterBuffer, FilterIsCaseSensitive, FilterMode);
 			*ProgramState = PROGRAM_STATE_BROWSING;
 			if (IndexIsOffscreen(*SelectedIndex, *StartDrawIndex, ConsoleRows))
 			{
 				*StartDrawIndex = CenterIndexByReturningStartDrawIndex(*SelectedIndex, *StartDrawIndex,
-																	   *EntryCount, ConsoleRows);
+																	   Listing->View.Count, ConsoleRows);
 			}
 		} break;
 
@@ -687,11 +3340,9 @@ SearchFilterInputCharacter(internal_directory_entry *EntriesBuffer, u32 *EntryCo
 			*SelectedIndex = 0;
 			*ProgramState = PROGRAM_STATE_BROWSING;
 
-			if (*EntryCount == 1)
+			if (Listing->View.Count == 1)
 			{
-				internal_directory_entry *Entry = &EntriesBuffer[0];
-				OpenFileOrEnterDirectory(Entry,
-				                         EntriesBuffer, EntryCount,
+				OpenFileOrEnterDirectory(Listing, Listing->View.Entries[0],
 				                         SelectedIndex, StartDrawIndex, ConsoleRows,
 				                         DirectoryPath, FilterHiddenEntries,
 				                         FilterBuffer, FilterBufferIndex, FilterIsCaseSensitive);
@@ -700,49 +3351,38 @@ SearchFilterInputCharacter(internal_directory_entry *EntriesBuffer, u32 *EntryCo
 
 			// NOTE(Felix): Add character to search (if it is valid) and update filter
 		default: {
-			if (0 == CharIsAsciiControlCharacter((char)InputCharacter) &&
+			if (InputCharacter < 256 && 0 == CharIsAsciiControlCharacter((char)InputCharacter) &&
 			    *FilterBufferIndex+2 < FilterBufferSize) // two spaces free - one for the new char, another one for 0 terminator
 			{
 				FilterBuffer[*FilterBufferIndex] = (char)InputCharacter;
 				*FilterBufferIndex += 1;
 				FilterBuffer[*FilterBufferIndex] = 0; // Zero terminate string
 
-				u32 Index = 0;
-				while (Index < *EntryCount)
+				DirectoryFilterUpdate(Listing, SelectedIndex, DirectoryPath, FilterHiddenEntries, 
+				                      FilterBuffer, FilterIsCaseSensitive, FilterMode);
+				if (Listing->IsStreamed)
 				{
-					if (FilterKeepEntry(EntriesBuffer[Index].Name, FilterHiddenEntries,
-					                    FilterBuffer, FilterIsCaseSensitive))
-					{
-						++Index;
-					}
-					else
-					{
-						// NOTE(Felix): Remove entry by copying (and thus overwriting)
-						// the rest of the entries one slot "down"
-						*EntryCount -= 1;
-						u32 SlotsToMove = *EntryCount - Index;
-						MemoryCopy(&EntriesBuffer[Index], &EntriesBuffer[Index+1], 
-						           sizeof(EntriesBuffer[0]) * SlotsToMove);
-					}
+					*StartDrawIndex = 0;
 				}
-				
 			}
 		} break;
 	}
-}
 
-internal void
-SignalSIGINTHandler(int Signal)
-{
-	ConsoleCleanup();
-	exit(-1);
+	// NOTE(Felix): Fuzzy results are ranked, keep the best match selected while typing
+	if (FilterMode == FILTER_MODE_FUZZY && *ProgramState != PROGRAM_STATE_BROWSING)
+	{
+		*SelectedIndex = 0;
+		*StartDrawIndex = 0;
+	}
 }
 
-internal void
-SignalSIGWINCHHandler(int Signal)
-{
-	GLOBALUpdateConsoleDimensions = 1;
-}
+// NOTE(Felix): Frame pacing. Input gets processed before anything is drawn, so when keys come
+// in faster than frames can be drawn (key repeat, slow terminal) only the latest state is 
+// drawn. At most one frame is drawn every FRAME_MIN_INTERVAL_MS, and no matter how much input
+// keeps coming in, a frame is never held back for longer than FRAME_MAX_LATENCY_MS.
+// Frames that don't change anything on screen aren't sent, see ScreenFlush
+#define FRAME_MIN_INTERVAL_MS 8
+#define FRAME_MAX_LATENCY_MS 50
 
 int
 main(i32 ArgumentCount, char **Arguments)
@@ -750,20 +3390,39 @@ main(i32 ArgumentCount, char **Arguments)
 	// NOTE(Felix): Disable printf stdout buffering
 	setvbuf(stdout, 0, _IONBF, 0);
 
-	// NOTE(Felix): Set signal so a CTRL-C restores console settings
+	// NOTE(Felix): Self checks run before anything touches the terminal, so they work without one
+	// "--substring-test" checks the vector substring search against the scalar one and exits
+	// "--job-stress" checks that the job system completes every job exactly once and exits
+	for (i32 ArgumentIndex = 1; ArgumentIndex < ArgumentCount; ++ArgumentIndex)
 	{
-		struct sigaction SignalAction = { 0 };
-		SignalAction.sa_handler = &SignalSIGINTHandler;
-		sigaction(SIGINT, &SignalAction, 0);
+		if (StringEqual(Arguments[ArgumentIndex], "--substring-test"))
+		{
+			return (SubstringMatchTestRun() ? 0 : -1);
+		}
+		if (StringEqual(Arguments[ArgumentIndex], "--job-stress"))
+		{
+			return (JobStressRun() ? 0 : -1);
+		}
 	}
 
-	// NOTE(Felix): Handle resize signal so we can reformat the window
+	// NOTE(Felix): How much address space listings may reserve, before any listing exists
+	DirectoryListingLimitsSet();
+
+	// NOTE(Felix): CTRL-C, resizes and children exiting arrive as events of the main loop
+	// (CTRL-C exits through the normal shutdown, which restores console settings).
+	// Has to happen before any thread is started
+	event_loop *EventLoop = &GLOBALEventLoop;
+	if (0 == EventLoopCreate(EventLoop, STDIN_FILENO))
 	{
-		struct sigaction SignalAction = { 0 };
-		SignalAction.sa_handler = &SignalSIGWINCHHandler;
-		sigaction(SIGWINCH, &SignalAction, 0);
+		fprintf(stderr, "Couldn't set up the event loop\n");
+		return (-1);
 	}
 
+	// NOTE(Felix): Filesystem work that may take long runs in the background (see job.c),
+	// finished jobs wake up the event loop
+	job_system *Jobs = &GLOBALJobs;
+	JobSystemStart(Jobs, (u32)MAX(sysconf(_SC_NPROCESSORS_ONLN), 1), EventLoop);
+
 	// NOTE(Felix): Disable buffering of input, we want to process it immediately
 	{
 		struct termios TerminalSettings = { 0 };
@@ -774,16 +3433,57 @@ main(i32 ArgumentCount, char **Arguments)
 
 	// NOTE(Felix): The user is able to pass a path as an argument - we'll just try to enter this directory
 	// if it doesn't work we stay in the current directory
-	// We'll also just use the first argument (after the program name itself)
-	if (ArgumentCount >= 2) // First argument is program name itself
+	// We'll also just use the first path argument (after the program name itself)
+	// "-s" starts in streaming mode (unsorted, constant memory, for enormous directories)
+	// "-l" starts with the long listing (size, modification time, permissions and owner)
+	// "--no-io-uring" fetches metadata with one statx per entry (see stat_ring.c)
+	// "--stat-benchmark" prints how fast metadata of the directory can be fetched and exits
+	// "--frame-stats" prints how much drawing cost on exit (see console_output)
+	// "--cache-stats" prints how often the directory cache was hit on exit (see directory_cache)
+	b32 StreamDirectories = 0;
+	b32 LongListing = 0;
+	b32 RunStatBenchmark = 0;
+	b32 PrintFrameStats = 0;
+	b32 PrintCacheStats = 0;
+	b32 PathArgumentUsed = 0;
+	for (i32 ArgumentIndex = 1; ArgumentIndex < ArgumentCount; ++ArgumentIndex) // First argument is program name itself
 	{
-		chdir(Arguments[1]);
+		if (StringEqual(Arguments[ArgumentIndex], "-s"))
+		{
+			StreamDirectories = 1;
+		}
+		else if (StringEqual(Arguments[ArgumentIndex], "-l"))
+		{
+			LongListing = 1;
+		}
+		else if (StringEqual(Arguments[ArgumentIndex], "--no-io-uring"))
+		{
+			GLOBALStatRingDisabled = 1;
+		}
+		else if (StringEqual(Arguments[ArgumentIndex], "--stat-benchmark"))
+		{
+			RunStatBenchmark = 1;
+		}
+		else if (StringEqual(Arguments[ArgumentIndex], "--frame-stats"))
+		{
+			PrintFrameStats = 1;
+		}
+		else if (StringEqual(Arguments[ArgumentIndex], "--cache-stats"))
+		{
+			PrintCacheStats = 1;
+		}
+		else if (0 == PathArgumentUsed)
+		{
+			chdir(Arguments[ArgumentIndex]);
+			PathArgumentUsed = 1;
+		}
 	}
 
 	// NOTE(Felix): Setup state and filter buffer two states will use
 	program_state ProgramState = PROGRAM_STATE_BROWSING;
 	b32 FilterHiddenEntries = 1;
 	b32 FilterIsCaseSensitive = 0;
+	filter_mode FilterMode = FILTER_MODE_SUBSTRING;
 	enum { FILTER_BUFFER_SIZE = 256 };
 	char FilterBuffer[FILTER_BUFFER_SIZE] = { 0 };
 	u32 FilterBufferIndex = 0;
@@ -793,12 +3493,24 @@ main(i32 ArgumentCount, char **Arguments)
 	getcwd(PathBuffer, sizeof(PathBuffer));
 	PathBuffer[(i32)StringLength(PathBuffer)] = '/';
 
+	if (RunStatBenchmark)
+	{
+		StatBenchmarkRun(PathBuffer, Jobs, EventLoop);
+		return (0);
+	}
+
 	// NOTE(Felix): Create and fill buffer that holds contents of current directory
-	u32 CurrentDirectoryEntriesBufferSize = MEBIBYTES(2);
-	internal_directory_entry *CurrentDirectoryEntriesBuffer = mmap(0, CurrentDirectoryEntriesBufferSize, PROT_READ|PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-	u32 CurrentDirectoryEntryCount = 0;
-	DirectoryReadIntoBufferAndFilter(CurrentDirectoryEntriesBuffer, &CurrentDirectoryEntryCount, PathBuffer, FilterHiddenEntries, 0, 0);
-	SortDirectoryEntries(CurrentDirectoryEntriesBuffer, CurrentDirectoryEntryCount);
+	// (big directories get loaded progressively, see DirectoryLoadStep)
+	directory_listing CurrentDirectoryListing = { 0 };
+	if (0 == DirectoryListingAllocate(&CurrentDirectoryListing))
+	{
+		fprintf(stderr, "Couldn't reserve memory for the directory listing\n");
+		return (-1);
+	}
+	CurrentDirectoryListing.IsStreamed = StreamDirectories;
+	i32 SelectedIndex = 0;
+	char PendingSelectionName[NAME_MAX+1] = { 0 };
+	DirectoryLoadBegin(&CurrentDirectoryListing, PathBuffer, &SelectedIndex, FilterHiddenEntries, 0, 0);
 
 	// NOTE(Felix): Prepare for drawing
 	ConsoleSetup();
@@ -807,359 +3519,665 @@ main(i32 ArgumentCount, char **Arguments)
 	i32 ConsoleRows = 0;
 	i32 ConsoleColumns = 0;
 	ConsoleUpdateDimensions(&ConsoleRows, &ConsoleColumns);
+	screen *Screen = &GLOBALScreen;
+	input_buffer *Input = &GLOBALInput;
+	ScreenResize(Screen, ConsoleRows, ConsoleColumns);
+	Screen->Output.UseSynchronizedUpdate = ConsoleSynchronizedUpdateQuery();
 
 	// NOTE(Felix): Draw
 	b32 ExitProgram = 0;
-	i32 SelectedIndex = 0;
+	b32 Redraw = 1;
 	i32 StartDrawIndex = 0;
+	u32 *LastDrawnEntries = 0;
+	u32 LastDrawnCount = 0;
+	i32 LastStartDrawIndex = 0;
+	u64 LastFrameTime = 0;
 	while (0 == ExitProgram)
 	{
-		// Rendering
+		// NOTE(Felix): Results of background jobs are taken in once per frame
+		if (JobSystemDrain(Jobs) > 0)
+		{
+			Redraw = 1;
+		}
+		if (DirectoryViewQueryStatsUpdate(&CurrentDirectoryListing, &SelectedIndex))
+		{
+			StartDrawIndex = UpdateStartDrawIndex((i32)CurrentDirectoryListing.View.Count, SelectedIndex, ConsoleRows);
+			Redraw = 1;
+		}
+
+		// NOTE(Felix): Typing ahead may have cancelled filtering, the view gets finished before
+		// anything is drawn. If even more input is waiting, that comes first
+		if (0 == DirectoryViewIsComplete(&CurrentDirectoryListing))
+		{
+			DirectoryViewFinish(&CurrentDirectoryListing, 1);
+		}
+
+		// NOTE(Felix): The long listing only fetches metadata of what is (about to be) on screen
+		if (LongListing)
+		{
+			DirectoryListingStatRequest(&CurrentDirectoryListing, Jobs, (u32)StartDrawIndex, (u32)(StartDrawIndex + ConsoleRows-2));
+		}
+
+		// NOTE(Felix): So does a query, but for the entries it couldn't decide on yet
+		DirectoryListingStatRequestQuery(&CurrentDirectoryListing, Jobs);
+
+		// NOTE(Felix): A directory the selection rests on is likely entered next, it gets read ahead of time
+		i32 PrefetchWaitMilliseconds = DirectoryPrefetchUpdate(&GLOBALDirectoryPrefetch, &CurrentDirectoryListing, 
+		                                                       SelectedIndex, PathBuffer, Jobs);
+
+		// NOTE(Felix): Frame pacing, see FRAME_MIN_INTERVAL_MS
+		b32 DrawNow = 0;
+		i32 FrameWaitMilliseconds = -1;
+		if (Redraw)
 		{
-			// Clear window
+			u64 SinceLastFrame = TimeGetMilliseconds() - LastFrameTime;
+			if (SinceLastFrame < FRAME_MIN_INTERVAL_MS)
 			{
-				ColorResetToDefault();
-				for (i32 Y = 0; Y < ConsoleRows; ++Y) 
-				{
-					CursorMoveTo(Y, 0);
-					ClearCurrentLine();
-				}
-				CursorMoveTo(0, 0);
+				FrameWaitMilliseconds = (i32)(FRAME_MIN_INTERVAL_MS - SinceLastFrame);
+			}
+			else if (SinceLastFrame >= FRAME_MAX_LATENCY_MS || 0 == InputIsPending())
+			{
+				DrawNow = 1;
+			}
+			else
+			{
+				FrameWaitMilliseconds = 0;
 			}
+		}
+
+		// Rendering
+		if (DrawNow)
+		{
+			// NOTE(Felix): The frame is drawn into the screen model, only what changed since the 
+			// last frame gets sent to the terminal (see screen.c)
+			ScreenBeginFrame(Screen, COLOR_DEFAULT_FOREGROUND, COLOR_DEFAULT_BACKGROUND);
 
 			// NOTE(Felix): Print outline Box
 			{
 				// Top
 				{
 					// Print path
-					CursorMoveTo(0, 0);
-					printf("%s", PathBuffer);
-					
-					// Fill rest
-					printf("\u255e");
-					for (i32 currentX = (i32)StringLength(PathBuffer) + 1;
-						 currentX+1 < ConsoleColumns; 
-						 ++currentX) 
+					ScreenMoveTo(Screen, 0, 0);
+					ScreenPrint(Screen, PathBuffer);
+					ScreenPrint(Screen, GLYPH_VERTICAL_TO_RIGHT);
+
+					// NOTE(Felix): Show progress while the directory is still being loaded
+					if (CurrentDirectoryListing.IsLoading)
 					{
-						printf("\u2550");
+						char LoadingText[64] = { 0 };
+						snprintf(LoadingText, sizeof(LoadingText), " %" PFu32 " entries loaded\u2026 ", 
+						         CurrentDirectoryListing.LoadedCount);
+						ScreenPrint(Screen, LoadingText);
 					}
+					else if (CurrentDirectoryListing.View.MissingStatCount > 0)
+					{
+						char FetchingText[64] = { 0 };
+						snprintf(FetchingText, sizeof(FetchingText), " fetching metadata of %" PFu32 " entries\u2026 ", 
+						         CurrentDirectoryListing.View.MissingStatCount);
+						ScreenPrint(Screen, FetchingText);
+					}
+					else if (CurrentDirectoryListing.IsTruncated)
+					{
+						char TruncatedText[64] = { 0 };
+						snprintf(TruncatedText, sizeof(TruncatedText), " only %" PFu32 " entries fit in memory ", 
+						         CurrentDirectoryListing.Count);
+						ScreenPrint(Screen, TruncatedText);
+					}
+					else if (CurrentDirectoryListing.IsStreamed)
+					{
+						directory_stream *Stream = &CurrentDirectoryListing.Stream;
+						char StreamText[64] = { 0 };
+						snprintf(StreamText, sizeof(StreamText), " unsorted %" PFu32 "/%" PFu32 "%s ",
+						         Stream->WindowStart + (u32)SelectedIndex + 1, Stream->KnownCount,
+						         Stream->ReachedEnd ? "" : "+");
+						ScreenPrint(Screen, StreamText);
+					}
+					
+					// Fill rest
+					ScreenPrintRepeated(Screen, GLYPH_HORIZONTAL, ConsoleColumns-1 - Screen->CursorX);
 				}
 				
 				// Top right corner
-				printf("\u2557");
+				ScreenPrint(Screen, GLYPH_TOP_RIGHT);
 				
 				// Right side
 				for (i32 Y = 1; Y < ConsoleRows-1; ++Y) 
 				{
-					CursorMoveTo(Y, ConsoleColumns-1);
-					printf("\u2551");
+					ScreenMoveTo(Screen, Y, ConsoleColumns-1);
+					ScreenPrint(Screen, GLYPH_VERTICAL);
 				}
 				
 				// Left side
 				{
-					CursorMoveTo(1, 0);
-					printf("\u2565");
+					ScreenMoveTo(Screen, 1, 0);
+					ScreenPrint(Screen, GLYPH_DOWN_FROM_DOUBLE);
 					for (i32 Y = 2; Y < ConsoleRows-2; ++Y) 
 					{
-						CursorMoveTo(Y, 0);
-						printf("\u2551");
+						ScreenMoveTo(Screen, Y, 0);
+						ScreenPrint(Screen, GLYPH_VERTICAL);
 					}
 				}
 
 				// Bottom
 				if (FilterBuffer[0] != 0 ||
 				    ProgramState == PROGRAM_STATE_ENTER_SEARCH_FILTER_CASE_INSENSITIVE ||
-				    ProgramState == PROGRAM_STATE_ENTER_SEARCH_FILTER_CASE_SENSITIVE)
+				    ProgramState == PROGRAM_STATE_ENTER_SEARCH_FILTER_CASE_SENSITIVE ||
+				    ProgramState == PROGRAM_STATE_ENTER_SEARCH_FILTER_FUZZY ||
+				    ProgramState == PROGRAM_STATE_ENTER_SEARCH_FILTER_PATTERN ||
+				    ProgramState == PROGRAM_STATE_ENTER_SEARCH_FILTER_QUERY)
 				{
 					// Display current search 
 
 					// Thing above bottom left corner
-					CursorMoveTo(ConsoleRows-2, 0);
-					printf("\u2568");
+					ScreenMoveTo(Screen, ConsoleRows-2, 0);
+					ScreenPrint(Screen, GLYPH_UP_FROM_DOUBLE);
 					
 					// Bottom contains current search
-					CursorMoveTo(ConsoleRows, 0);
+					ScreenMoveTo(Screen, ConsoleRows-1, 0);
 					char *SearchStringPreRamble = (FilterIsCaseSensitive) ? "(Case sensitive): " : ("Case insensitive: ");
-					printf("%s%s", SearchStringPreRamble, FilterBuffer);
-
-					// Bottom side
-					printf("\u255e");
-					for (i32 currentX = (i32)StringLength(SearchStringPreRamble) + (i32)FilterBufferIndex + 1; 
-						 currentX < ConsoleColumns-1; 
-						 ++currentX) 
+					if (FilterMode == FILTER_MODE_FUZZY)
+					{
+						SearchStringPreRamble = "Fuzzy: ";
+					}
+					else if (FilterMode == FILTER_MODE_PATTERN)
 					{
-						printf("\u2550");
+						SearchStringPreRamble = CurrentDirectoryListing.View.FilterIsInvalid ? "Pattern (incomplete): " : "Pattern: ";
 					}
+					else if (FilterMode == FILTER_MODE_QUERY)
+					{
+						SearchStringPreRamble = CurrentDirectoryListing.View.FilterIsInvalid ? "Query (incomplete): " : "Query: ";
+					}
+					ScreenPrint(Screen, SearchStringPreRamble);
+					ScreenPrint(Screen, FilterBuffer);
+
+					// Bottom side
+					ScreenPrint(Screen, GLYPH_VERTICAL_TO_RIGHT);
+					ScreenPrintRepeated(Screen, GLYPH_HORIZONTAL, ConsoleColumns-1 - Screen->CursorX);
 					
 					// Bottom right corner
-					printf("\u255d");
+					ScreenPrint(Screen, GLYPH_BOTTOM_RIGHT);
 				}
 				else
 				{
 					// Just draw box outline
 					 
 					// Thing above bottom left corner
-					CursorMoveTo(ConsoleRows-2, 0);
-					printf("\u2551");
+					ScreenMoveTo(Screen, ConsoleRows-2, 0);
+					ScreenPrint(Screen, GLYPH_VERTICAL);
 					
 					// Bottom Left corner
-					CursorMoveTo(ConsoleRows-1, 0);
-					printf("\u255a");
+					ScreenMoveTo(Screen, ConsoleRows-1, 0);
+					ScreenPrint(Screen, GLYPH_BOTTOM_LEFT);
 					
 					// Bottom side
-					for (i32 currentX = 1; currentX < ConsoleColumns-1; ++currentX) 
-					{
-						printf("\u2550");
-					}
+					ScreenPrintRepeated(Screen, GLYPH_HORIZONTAL, ConsoleColumns-2);
 					
 					// Bottom right corner
-					printf("\u255d");
+					ScreenPrint(Screen, GLYPH_BOTTOM_RIGHT);
 				}
 			}
 
-			if (CurrentDirectoryEntryCount > 0)
+			if (CurrentDirectoryListing.View.Count > 0)
 			{
 				// NOTE(Felix): Print all valid entries
+				i64 Now = (i64)time(0);
 				for (i32 InternalEntryIndex = StartDrawIndex;
-				     InternalEntryIndex < MIN(StartDrawIndex + ConsoleRows - 2, (i32)CurrentDirectoryEntryCount);
+				     InternalEntryIndex < MIN(StartDrawIndex + ConsoleRows - 2, (i32)CurrentDirectoryListing.View.Count);
 				     ++InternalEntryIndex)
 				{
-					internal_directory_entry CurrentEntry = CurrentDirectoryEntriesBuffer[InternalEntryIndex];
-					CursorMoveTo((i32)InternalEntryIndex-StartDrawIndex+1, 1);
+					ScreenMoveTo(Screen, (i32)InternalEntryIndex-StartDrawIndex+1, 1);
 
-					color LineColor = LineColorGetFromEntry(CurrentEntry, (i32)InternalEntryIndex == SelectedIndex);
-					ColorSet(LineColor);
-					//ClearCurrentLine();
-					printf("%s", CurrentEntry.Name);
+					u32 EntryIndex = CurrentDirectoryListing.View.Entries[InternalEntryIndex];
+					entry_type EntryType = CurrentDirectoryListing.Type[EntryIndex];
+					color LineColor = LineColorGetFromEntry(EntryType, (i32)InternalEntryIndex == SelectedIndex);
+					ScreenColorSetFromColor(Screen, LineColor);
+					if (LongListing)
+					{
+						char Columns[128];
+						DirectoryListingColumnsFormat(&CurrentDirectoryListing, EntryIndex, Now, Columns, sizeof(Columns));
+						ScreenPrint(Screen, Columns);
+					}
+					ScreenPrint(Screen, DirectoryListingName(&CurrentDirectoryListing, EntryIndex));
 				}
 			}
 			else
 			{
 				// NOTE(Felix): Display that this directory is empty
-				CursorMoveTo(1, 1);
+				ScreenMoveTo(Screen, 1, 1);
 				color LineColor = { 0 };
 				LineColor.Background = COLOR_DEFAULT_BACKGROUND;
 				LineColor.Foreground = COLOR_UNSELECTED_FOREGROUND_DIRECTORY;
-				ColorSet(LineColor);
-				printf("<empty>");
+				ScreenColorSetFromColor(Screen, LineColor);
+				ScreenPrint(Screen, "<empty>");
 			}
+
+			// NOTE(Felix): Moving through the same list only shifts the rows that were there 
+			// already, the terminal gets to scroll them (rows of the box, borders included)
+			directory_view *View = &CurrentDirectoryListing.View;
+			if (View->Entries == LastDrawnEntries && View->Count == LastDrawnCount &&
+			    StartDrawIndex != LastStartDrawIndex)
+			{
+				ScreenScroll(Screen, 1, ConsoleRows-2, StartDrawIndex - LastStartDrawIndex);
+			}
+			LastDrawnEntries = View->Entries;
+			LastDrawnCount = View->Count;
+			LastStartDrawIndex = StartDrawIndex;
+
+			ScreenFlush(Screen);
+			LastFrameTime = TimeGetMilliseconds();
+			Redraw = 0;
 		}
 
 
 		// NOTE(Felix): Get input (and/or catch resize of window)
-		int InputCharacter = 0;
 		{
-			struct pollfd PollRequest = { 0 };
-			PollRequest.fd = STDIN_FILENO;
-			PollRequest.events = POLLIN;
-
 			// NOTE(Felix): Wait for either
 			//  - Input
-			//  - Interrupt of any kind (including resizing of console)
-			poll(&PollRequest, 1, -1);
+			//  - A signal (resizing of console, CTRL-C, a child exiting)
+			//  - The next frame (or prefetch) being due
+			//  - Some other thread waking us up
+			// While a directory is still loading we only check and keep loading otherwise
+			i32 WaitTimeout = -1;
+			if (CurrentDirectoryListing.IsLoading || FrameWaitMilliseconds == 0)
+			{
+				WaitTimeout = 0;
+			}
+			else if (FrameWaitMilliseconds > 0 || PrefetchWaitMilliseconds > 0)
+			{
+				// NOTE(Felix): One timer for both, whichever is due first
+				i32 TimerMilliseconds = (FrameWaitMilliseconds > 0) ? FrameWaitMilliseconds : PrefetchWaitMilliseconds;
+				if (PrefetchWaitMilliseconds > 0)
+				{
+					TimerMilliseconds = MIN(TimerMilliseconds, PrefetchWaitMilliseconds);
+				}
+				EventLoopTimerSet(EventLoop, TimerMilliseconds);
+			}
+			event_loop_events Events = { 0 };
+			EventLoopWait(EventLoop, WaitTimeout, &Events);
+
+			if (Events.WasInterrupted)
+			{
+				ExitProgram = 1;
+				continue;
+			}
+
+			if (Events.ChildExited)
+			{
+				// NOTE(Felix): Children we didn't wait for already (double forked ones get
+				// waited for right away, see OpenFileOrEnterDirectory)
+				while (waitpid(-1, 0, WNOHANG) > 0);
+			}
 
-			if (GLOBALUpdateConsoleDimensions)
+			if (Events.WasResized)
 			{
 				// NOTE(Felix): Update Dimensions and force redraw
 				ConsoleUpdateDimensions(&ConsoleRows, &ConsoleColumns);
-				StartDrawIndex = UpdateStartDrawIndex((i32)CurrentDirectoryEntryCount, SelectedIndex, ConsoleRows);
-				GLOBALUpdateConsoleDimensions = 0;
+				ScreenResize(Screen, ConsoleRows, ConsoleColumns);
+				StartDrawIndex = UpdateStartDrawIndex((i32)CurrentDirectoryListing.View.Count, SelectedIndex, ConsoleRows);
+				Redraw = 1;
+				continue;
+			}
+
+			if (0 == Events.InputIsReady)
+			{
+				// NOTE(Felix): No input, read the next chunk of the directory (or draw the frame 
+				// that is due now)
+				b32 LoadedMore = DirectoryLoadStep(&CurrentDirectoryListing, &SelectedIndex);
+				DirectoryLoadSelectPending(&CurrentDirectoryListing, &SelectedIndex, PendingSelectionName);
+				if (LoadedMore)
+				{
+					StartDrawIndex = UpdateStartDrawIndex((i32)CurrentDirectoryListing.View.Count, SelectedIndex, ConsoleRows);
+					Redraw = 1;
+				}
 				continue;
 			}
 
-			read(STDIN_FILENO, &InputCharacter, sizeof(InputCharacter));
+			InputRead(Input, STDIN_FILENO);
 		}
 
 
-		// NOTE(Felix): Input is dependant on program state
-		switch (ProgramState)
+		// NOTE(Felix): Every key event gets handled before the next frame is drawn. An event can
+		// stand for many presses of a motion key (see input.c), those are applied at once
+		input_event Event = { 0 };
+		while (0 == ExitProgram && (Event.Count > 0 || InputEventNext(Input, &Event)))
 		{
-			// NOTE(Felix): Input characters are mapped to do different things
-			case PROGRAM_STATE_BROWSING: {
-				switch (InputCharacter)
-				{
-					// NOTE(Felix): Move down
-					case 'j': {
-						SelectedIndex = MIN((i32)CurrentDirectoryEntryCount-1, SelectedIndex+1);
-						StartDrawIndex = UpdateStartDrawIndex((i32)CurrentDirectoryEntryCount, SelectedIndex, ConsoleRows);
-					} break;
-
-					// NOTE(Felix): Move Up
-					case 'k': {
-						SelectedIndex = MAX(0, SelectedIndex-1);
-						StartDrawIndex = UpdateStartDrawIndex((i32)CurrentDirectoryEntryCount, SelectedIndex, ConsoleRows);
-					} break;
-
-					// NOTE(Felix): Leave directory
-					case 'h': {
-						// NOTE(Felix): Make sure we're not in the "root directory"
-						if (0 == (PathBuffer[0] == '/' && PathBuffer[1] == 0))
-						{
+			i32 InputCharacter = Event.Key;
+			u32 RepeatCount = 1; // Motions use up every repetition at once
+			Redraw = 1;
+
+			// NOTE(Felix): Any input means the user took over the selection
+			PendingSelectionName[0] = 0;
+
+			// NOTE(Felix): Only editing the filter works on top of an unfinished view, 
+			// everything else needs to see all of it
+			b32 IsEnteringFilter = (ProgramState == PROGRAM_STATE_ENTER_SEARCH_FILTER_CASE_SENSITIVE ||
+			                        ProgramState == PROGRAM_STATE_ENTER_SEARCH_FILTER_CASE_INSENSITIVE ||
+			                        ProgramState == PROGRAM_STATE_ENTER_SEARCH_FILTER_FUZZY ||
+			                        ProgramState == PROGRAM_STATE_ENTER_SEARCH_FILTER_PATTERN ||
+			                        ProgramState == PROGRAM_STATE_ENTER_SEARCH_FILTER_QUERY);
+			if (0 == IsEnteringFilter || InputCharacter == '\n')
+			{
+				DirectoryViewFinish(&CurrentDirectoryListing, 0);
+			}
+
+			// NOTE(Felix): Input is dependant on program state
+			switch (ProgramState)
+			{
+				// NOTE(Felix): Input characters are mapped to do different things
+				case PROGRAM_STATE_BROWSING: {
+					switch (InputCharacter)
+					{
+						// NOTE(Felix): Move down
+						case INPUT_KEY_DOWN:
+						case 'j': {
+							RepeatCount = Event.Count;
+							SelectedIndex = MIN((i32)CurrentDirectoryListing.View.Count-1, SelectedIndex+(i32)RepeatCount);
+							StartDrawIndex = UpdateStartDrawIndex((i32)CurrentDirectoryListing.View.Count, SelectedIndex, ConsoleRows);
+						} break;
+
+						// NOTE(Felix): Move Up
+						case INPUT_KEY_UP:
+						case 'k': {
+							RepeatCount = Event.Count;
+							SelectedIndex = MAX(0, SelectedIndex-(i32)RepeatCount);
+							StartDrawIndex = UpdateStartDrawIndex((i32)CurrentDirectoryListing.View.Count, SelectedIndex, ConsoleRows);
+						} break;
+
+						// NOTE(Felix): Leave directory
+						case INPUT_KEY_LEFT:
+						case 'h': {
+							// NOTE(Felix): Make sure we're not in the "root directory"
+							if (0 == (PathBuffer[0] == '/' && PathBuffer[1] == 0))
+							{
+								ClearFilter(FilterBuffer, &FilterBufferIndex);
+
+								// NOTE(Felix): We want to automatically select the folder we just left
+								// (as soon as it has been loaded)
+								ReadCurrentDirectoryNameIntoBuffer(PendingSelectionName, PathBuffer);
+								LeaveDirectory(PathBuffer);
+								b32 WasCached = DirectoryChange(&CurrentDirectoryListing, PathBuffer, &SelectedIndex, &StartDrawIndex,
+								                                FilterHiddenEntries, FilterBuffer, &FilterBufferIndex, FilterIsCaseSensitive);
+								FilterMode = CurrentDirectoryListing.View.FilterMode;
+
+								// NOTE(Felix): A listing from the cache usually has that folder selected
+								// already, then the view stays exactly as we left it
+								directory_view *View = &CurrentDirectoryListing.View;
+								if (WasCached && (u32)SelectedIndex < View->Count &&
+								    StringEqual(DirectoryListingName(&CurrentDirectoryListing, View->Entries[SelectedIndex]), PendingSelectionName))
+								{
+									PendingSelectionName[0] = 0;
+									if (IndexIsOffscreen(SelectedIndex, StartDrawIndex, ConsoleRows-2))
+									{
+										StartDrawIndex = UpdateStartDrawIndex((i32)View->Count, SelectedIndex, ConsoleRows);
+									}
+								}
+								else
+								{
+									DirectoryLoadSelectPending(&CurrentDirectoryListing, &SelectedIndex, PendingSelectionName);
+
+									// NOTE(Felix): Center selection
+									StartDrawIndex = UpdateStartDrawIndex((i32)CurrentDirectoryListing.View.Count, SelectedIndex, ConsoleRows);
+								}
+							}
+						} break;
+
+						// NOTE(Felix): Open file or enter directory
+						case INPUT_KEY_RIGHT:
+						case 'l': {
+							if ((u32)SelectedIndex < CurrentDirectoryListing.View.Count)
+							{
+								OpenFileOrEnterDirectory(&CurrentDirectoryListing, CurrentDirectoryListing.View.Entries[SelectedIndex],
+								                         &SelectedIndex, &StartDrawIndex, ConsoleRows,
+								                         PathBuffer, FilterHiddenEntries,
+								                         FilterBuffer, &FilterBufferIndex, FilterIsCaseSensitive);
+								FilterMode = CurrentDirectoryListing.View.FilterMode;
+							}
+						} break;
+
+						// NOTE(Felix): Toggle hidden files 
+						case 't': {
+							FilterHiddenEntries = !FilterHiddenEntries;
+							if (CurrentDirectoryListing.IsStreamed)
+							{
+								RefreshCurrentDirectory(&CurrentDirectoryListing, &SelectedIndex, PendingSelectionName, PathBuffer,
+								                        FilterHiddenEntries, FilterBuffer, FilterIsCaseSensitive);
+							}
+							else
+							{
+								// NOTE(Felix): Only the view changes, keep the selected entry selected if it is still shown
+								directory_view *View = &CurrentDirectoryListing.View;
+								i32 SelectedEntry = ((u32)SelectedIndex < View->Count) ? (i32)View->Entries[SelectedIndex] : -1;
+								DirectoryViewSetFilter(&CurrentDirectoryListing, FilterHiddenEntries, 
+								                       View->Filter, View->FilterIsCaseSensitive, View->FilterMode, 0);
+								SelectedIndex = (SelectedEntry >= 0) ? MAX(0, DirectoryViewRowFromEntry(&CurrentDirectoryListing, (u32)SelectedEntry)) : 0;
+							}
+						} break;
+
+						// NOTE(Felix): Toggle streaming (unsorted, only a window of the directory in memory)
+						case 's': {
+							CurrentDirectoryListing.IsStreamed = !CurrentDirectoryListing.IsStreamed;
+							RefreshCurrentDirectory(&CurrentDirectoryListing, &SelectedIndex, PendingSelectionName, PathBuffer,
+							                        FilterHiddenEntries, FilterBuffer, FilterIsCaseSensitive);
+							StartDrawIndex = UpdateStartDrawIndex((i32)CurrentDirectoryListing.View.Count, SelectedIndex, ConsoleRows);
+						} break;
+
+						// NOTE(Felix): Toggle long listing
+						case 'i': {
+							LongListing = !LongListing;
+						} break;
+
+						// NOTE(Felix): Force refresh
+						case 'r': {
+							RefreshCurrentDirectory(&CurrentDirectoryListing, &SelectedIndex, PendingSelectionName, PathBuffer,
+							                        FilterHiddenEntries, FilterBuffer, FilterIsCaseSensitive);
+						} break;
+
+						// NOTE(Felix): Jump to top (first Directory)
+						case INPUT_KEY_HOME:
+						case 'd': {
+							if (CurrentDirectoryListing.IsStreamed)
+							{
+								DirectoryStreamFillWindow(&CurrentDirectoryListing, 0);
+							}
+							SelectedIndex = 0;
+							StartDrawIndex = 0;
+						} break;
+
+						// NOTE(Felix): Jump to first file 
+						case 'f': {
+							if (CurrentDirectoryListing.View.Count > 0)
+							{
+								i32 FirstFileIndex = DirectoryGetFirstFileEntryIndex(&CurrentDirectoryListing);
+								FirstFileIndex = CLAMP(FirstFileIndex, 0, (i32)CurrentDirectoryListing.View.Count-1);
+								SelectedIndex = FirstFileIndex;
+								StartDrawIndex = UpdateStartDrawIndex((i32)CurrentDirectoryListing.View.Count, SelectedIndex, ConsoleRows);
+							}
+						} break;
+
+						// NOTE(Felix): Jump to end
+						case INPUT_KEY_END:
+						case 'e': {
+							if (CurrentDirectoryListing.IsStreamed)
+							{
+								DirectoryStreamJumpToEnd(&CurrentDirectoryListing);
+							}
+							SelectedIndex = (i32)CurrentDirectoryListing.View.Count-1;
+							StartDrawIndex = UpdateStartDrawIndex((i32)CurrentDirectoryListing.View.Count, SelectedIndex, ConsoleRows);
+						} break;
+
+						// NOTE(Felix): Try to jump to character given afterwards
+						case 'g': {
+							ProgramState = PROGRAM_STATE_AWAITING_JUMP_CHARACTER;
+						} break;
+
+						// NOTE(Felix): Filter case   sensitive
+						case '/': {
+							StartDrawIndex = 0;
+							ProgramState = PROGRAM_STATE_ENTER_SEARCH_FILTER_CASE_INSENSITIVE;
+							FilterMode = FILTER_MODE_SUBSTRING;
+							ClearFilter(FilterBuffer, &FilterBufferIndex);
+							DirectoryFilterUpdate(&CurrentDirectoryListing, &SelectedIndex, PathBuffer, 
+							                      FilterHiddenEntries, FilterBuffer, FilterIsCaseSensitive, FilterMode);
+						} break;
+
+						// NOTE(Felix): Filter case insensitive
+						case '?': {
+							StartDrawIndex = 0;
+							ProgramState = PROGRAM_STATE_ENTER_SEARCH_FILTER_CASE_SENSITIVE;
+							FilterMode = FILTER_MODE_SUBSTRING;
+							ClearFilter(FilterBuffer, &FilterBufferIndex);
+							DirectoryFilterUpdate(&CurrentDirectoryListing, &SelectedIndex, PathBuffer, 
+							                      FilterHiddenEntries, FilterBuffer, FilterIsCaseSensitive, FilterMode);
+						} break;
+
+						// NOTE(Felix): Fuzzy filter, results ranked by how well they match
+						case 'z': {
+							StartDrawIndex = 0;
+							ProgramState = PROGRAM_STATE_ENTER_SEARCH_FILTER_FUZZY;
+							FilterMode = FILTER_MODE_FUZZY;
+							ClearFilter(FilterBuffer, &FilterBufferIndex);
+							DirectoryFilterUpdate(&CurrentDirectoryListing, &SelectedIndex, PathBuffer, 
+							                      FilterHiddenEntries, FilterBuffer, FilterIsCaseSensitive, FilterMode);
+						} break;
+
+						// NOTE(Felix): Glob / regular expression filter
+						case 'p': {
+							StartDrawIndex = 0;
+							ProgramState = PROGRAM_STATE_ENTER_SEARCH_FILTER_PATTERN;
+							FilterMode = FILTER_MODE_PATTERN;
+							ClearFilter(FilterBuffer, &FilterBufferIndex);
+							DirectoryFilterUpdate(&CurrentDirectoryListing, &SelectedIndex, PathBuffer, 
+							                      FilterHiddenEntries, FilterBuffer, FilterIsCaseSensitive, FilterMode);
+						} break;
+
+						// NOTE(Felix): Filter by metadata (and name)
+						case 'm': {
+							StartDrawIndex = 0;
+							ProgramState = PROGRAM_STATE_ENTER_SEARCH_FILTER_QUERY;
+							FilterMode = FILTER_MODE_QUERY;
+							ClearFilter(FilterBuffer, &FilterBufferIndex);
+							DirectoryFilterUpdate(&CurrentDirectoryListing, &SelectedIndex, PathBuffer, 
+							                      FilterHiddenEntries, FilterBuffer, FilterIsCaseSensitive, FilterMode);
+						} break;
+
+						// NOTE(Felix): Reset filter
+						case 27: { // ESC
 							ClearFilter(FilterBuffer, &FilterBufferIndex);
+							DirectoryFilterUpdate(&CurrentDirectoryListing, &SelectedIndex, PathBuffer, 
+							                      FilterHiddenEntries, FilterBuffer, FilterIsCaseSensitive, FilterMode);
+						} break;
+
+						// NOTE(Felix): Skip a page forward
+						case INPUT_KEY_PAGE_DOWN:
+						case 6: { // CTRL-F
+							RepeatCount = Event.Count;
+							i32 EntriesDisplayed = (ConsoleRows-2)*(i32)RepeatCount;
+							SelectedIndex = CLAMP(0, SelectedIndex+EntriesDisplayed, (i32)CurrentDirectoryListing.View.Count-1);
+							StartDrawIndex = UpdateStartDrawIndex((i32)CurrentDirectoryListing.View.Count, SelectedIndex, ConsoleRows);
+						} break;
+
+						// NOTE(Felix): Skip a page backward
+						case INPUT_KEY_PAGE_UP:
+						case 2: { // CTRL-B
+							RepeatCount = Event.Count;
+							i32 EntriesDisplayed = (ConsoleRows-2)*(i32)RepeatCount;
+							SelectedIndex = CLAMP(0, SelectedIndex-EntriesDisplayed, (i32)CurrentDirectoryListing.View.Count-1);
+							StartDrawIndex = UpdateStartDrawIndex((i32)CurrentDirectoryListing.View.Count, SelectedIndex, ConsoleRows);
+						} break;
+
+						// NOTE(Felix): Exit program
+						case 'q': {
+							ExitProgram = 1;
+						} break;
+
+						// NOTE(Felix): Unbound key
+						default: {
+							// noop;
+						} break;
+					}
+				} break;
 
-							// NOTE(Felix): We want to automatically select the folder we just left
-							char PreviousDirectoryStringBuffer[PATH_MAX] = { 0 };
-							ReadCurrentDirectoryNameIntoBuffer(PreviousDirectoryStringBuffer, PathBuffer);
-							LeaveDirectory(PathBuffer);
-							DirectoryReadIntoBufferAndFilter(CurrentDirectoryEntriesBuffer, &CurrentDirectoryEntryCount, PathBuffer, 
-							                                 FilterHiddenEntries, FilterBuffer, FilterIsCaseSensitive);
-							SelectedIndex = DirectoryGetIndexFromName(CurrentDirectoryEntriesBuffer, CurrentDirectoryEntryCount, PreviousDirectoryStringBuffer);
 
-							// NOTE(Felix): Center selection
-							StartDrawIndex = UpdateStartDrawIndex((i32)CurrentDirectoryEntryCount, SelectedIndex, ConsoleRows);
-						}
-					} break;
-
-					// NOTE(Felix): Open file or enter directory
-					case 'l': {
-						internal_directory_entry *Entry = &CurrentDirectoryEntriesBuffer[SelectedIndex];
-						OpenFileOrEnterDirectory(Entry, 
-						                         CurrentDirectoryEntriesBuffer, &CurrentDirectoryEntryCount,
-						                         &SelectedIndex, &StartDrawIndex, ConsoleRows,
-						                         PathBuffer, FilterHiddenEntries,
-						                         FilterBuffer, &FilterBufferIndex, FilterIsCaseSensitive);
-					} break;
-
-					// NOTE(Felix): Toggle hidden files 
-					case 't': {
-						FilterHiddenEntries = !FilterHiddenEntries;
-						RefreshCurrentDirectory(CurrentDirectoryEntriesBuffer, &CurrentDirectoryEntryCount, &SelectedIndex, PathBuffer,
-						                        FilterHiddenEntries, FilterBuffer, FilterIsCaseSensitive);
-					} break;
-
-					// NOTE(Felix): Force refresh
-					case 'r': {
-						RefreshCurrentDirectory(CurrentDirectoryEntriesBuffer, &CurrentDirectoryEntryCount, &SelectedIndex, PathBuffer,
-						                        FilterHiddenEntries, FilterBuffer, FilterIsCaseSensitive);
-					} break;
-
-					// NOTE(Felix): Jump to top (first Directory)
-					case 'd': {
-						SelectedIndex = 0;
-						StartDrawIndex = 0;
-					} break;
-
-					// NOTE(Felix): Jump to first file 
-					case 'f': {
-						if (CurrentDirectoryEntryCount > 0)
+				// NOTE(Felix): Jump to first entry starting with InputCharacter
+				case PROGRAM_STATE_AWAITING_JUMP_CHARACTER: {
+					InputCharacter = CharToLowerIfIsLetter((char)InputCharacter);
+					i32 IndexToJumpTo = -1;
+					for (i32 Index = 0; Index < (i32)CurrentDirectoryListing.View.Count; ++Index)
+					{
+						char StartingCharacter = CharToLowerIfIsLetter(DirectoryListingName(&CurrentDirectoryListing, CurrentDirectoryListing.View.Entries[Index])[0]);
+						if (StartingCharacter == InputCharacter)
 						{
-							i32 FirstFileIndex = DirectoryGetFirstFileEntryIndex(CurrentDirectoryEntriesBuffer, CurrentDirectoryEntryCount);
-							FirstFileIndex = CLAMP(FirstFileIndex, 0, (i32)CurrentDirectoryEntryCount-1);
-							SelectedIndex = FirstFileIndex;
-							StartDrawIndex = UpdateStartDrawIndex((i32)CurrentDirectoryEntryCount, SelectedIndex, ConsoleRows);
+							IndexToJumpTo = Index;
+							break;
 						}
-					} break;
-
-					// NOTE(Felix): Jump to end
-					case 'e': {
-						SelectedIndex = (i32)CurrentDirectoryEntryCount-1;
-						StartDrawIndex = UpdateStartDrawIndex((i32)CurrentDirectoryEntryCount, SelectedIndex, ConsoleRows);
-					} break;
-
-					// NOTE(Felix): Try to jump to character given afterwards
-					case 'g': {
-						ProgramState = PROGRAM_STATE_AWAITING_JUMP_CHARACTER;
-					} break;
-
-					// NOTE(Felix): Filter case   sensitive
-					case '/': {
-						StartDrawIndex = 0;
-						ProgramState = PROGRAM_STATE_ENTER_SEARCH_FILTER_CASE_INSENSITIVE;
-						ClearFilter(FilterBuffer, &FilterBufferIndex);
-						DirectoryReadIntoBufferAndFilter(CurrentDirectoryEntriesBuffer, &CurrentDirectoryEntryCount,
-						                                 PathBuffer, FilterHiddenEntries,
-						                                 0, 0);
-					} break;
-
-					// NOTE(Felix): Filter case insensitive
-					case '?': {
-						StartDrawIndex = 0;
-						ProgramState = PROGRAM_STATE_ENTER_SEARCH_FILTER_CASE_SENSITIVE;
-						ClearFilter(FilterBuffer, &FilterBufferIndex);
-						DirectoryReadIntoBufferAndFilter(CurrentDirectoryEntriesBuffer, &CurrentDirectoryEntryCount,
-						                                 PathBuffer, FilterHiddenEntries,
-						                                 0, 0);
-					} break;
-
-					// NOTE(Felix): Reset filter
-					case 27: { // ESC
-						ClearFilter(FilterBuffer, &FilterBufferIndex);
-						DirectoryReadIntoBufferAndFilter(CurrentDirectoryEntriesBuffer, &CurrentDirectoryEntryCount,
-						                                 PathBuffer, FilterHiddenEntries,
-						                                 0, 0);
-					} break;
-
-					// NOTE(Felix): Skip a page forward
-					case 6: { // CTRL-F
-						i32 EntriesDisplayed = ConsoleRows-2;
-						SelectedIndex = CLAMP(0, SelectedIndex+EntriesDisplayed, (i32)CurrentDirectoryEntryCount-1);
-						StartDrawIndex = UpdateStartDrawIndex((i32)CurrentDirectoryEntryCount, SelectedIndex, ConsoleRows);
-					} break;
-
-					// NOTE(Felix): Skip a page backward
-					case 2: { // CTRL-B
-						i32 EntriesDisplayed = ConsoleRows-2;
-						SelectedIndex = CLAMP(0, SelectedIndex-EntriesDisplayed, (i32)CurrentDirectoryEntryCount-1);
-						StartDrawIndex = UpdateStartDrawIndex((i32)CurrentDirectoryEntryCount, SelectedIndex, ConsoleRows);
-					} break;
-
-					// NOTE(Felix): Exit program
-					case 'q': {
-						ExitProgram = 1;
-					} break;
-
-					// NOTE(Felix): Unbound key
-					default: {
-						// noop;
-					} break;
-				}
-			} break;
-
+					}
 
-			// NOTE(Felix): Jump to first entry starting with InputCharacter
-			case PROGRAM_STATE_AWAITING_JUMP_CHARACTER: {
-				InputCharacter = CharToLowerIfIsLetter((char)InputCharacter);
-				i32 IndexToJumpTo = -1;
-				for (i32 Index = 0; Index < (i32)CurrentDirectoryEntryCount; ++Index)
-				{
-					char StartingCharacter = CharToLowerIfIsLetter(CurrentDirectoryEntriesBuffer[Index].Name[0]);
-					if (StartingCharacter == InputCharacter)
+					if (IndexToJumpTo >= 0)
 					{
-						IndexToJumpTo = Index;
-						break;
+						SelectedIndex = IndexToJumpTo;
+						StartDrawIndex = UpdateStartDrawIndex((i32)CurrentDirectoryListing.View.Count, SelectedIndex, ConsoleRows);
 					}
-				}
-
-				if (IndexToJumpTo >= 0)
-				{
-					SelectedIndex = IndexToJumpTo;
-					StartDrawIndex = UpdateStartDrawIndex((i32)CurrentDirectoryEntryCount, SelectedIndex, ConsoleRows);
-				}
-
-				ProgramState = PROGRAM_STATE_BROWSING;
-			} break;
 
+					ProgramState = PROGRAM_STATE_BROWSING;
+				} break;
+
+
+				case PROGRAM_STATE_ENTER_SEARCH_FILTER_CASE_SENSITIVE: {
+					SearchFilterInputCharacter(&CurrentDirectoryListing, 
+					                           &SelectedIndex, &StartDrawIndex, ConsoleRows,
+					                           PathBuffer, FilterHiddenEntries,
+					                           FilterBuffer, &FilterBufferIndex, FILTER_BUFFER_SIZE,
+					                           &ProgramState, InputCharacter, 1, FilterMode);
+				} break;
+
+				case PROGRAM_STATE_ENTER_SEARCH_FILTER_CASE_INSENSITIVE: {
+					SearchFilterInputCharacter(&CurrentDirectoryListing, 
+					                           &SelectedIndex, &StartDrawIndex, ConsoleRows,
+					                           PathBuffer, FilterHiddenEntries, 
+					                           FilterBuffer, &FilterBufferIndex, FILTER_BUFFER_SIZE,
+					                           &ProgramState, InputCharacter, 0, FilterMode);
+				} break;
+
+				case PROGRAM_STATE_ENTER_SEARCH_FILTER_FUZZY:
+				case PROGRAM_STATE_ENTER_SEARCH_FILTER_PATTERN:
+				case PROGRAM_STATE_ENTER_SEARCH_FILTER_QUERY: {
+					SearchFilterInputCharacter(&CurrentDirectoryListing, 
+					                           &SelectedIndex, &StartDrawIndex, ConsoleRows,
+					                           PathBuffer, FilterHiddenEntries, 
+					                           FilterBuffer, &FilterBufferIndex, FILTER_BUFFER_SIZE,
+					                           &ProgramState, InputCharacter, 0, FilterMode);
+				} break;
+			}
 
-			case PROGRAM_STATE_ENTER_SEARCH_FILTER_CASE_SENSITIVE: {
-				SearchFilterInputCharacter(CurrentDirectoryEntriesBuffer, &CurrentDirectoryEntryCount, 
-				                           &SelectedIndex, &StartDrawIndex, ConsoleRows,
-				                           PathBuffer, FilterHiddenEntries,
-				                           FilterBuffer, &FilterBufferIndex, FILTER_BUFFER_SIZE,
-				                           &ProgramState, InputCharacter, 1);
-			} break;
+			// NOTE(Felix): Streamed listings move their window along with the selection
+			DirectoryStreamFollowSelection(&CurrentDirectoryListing, &SelectedIndex, &StartDrawIndex);
 
-			case PROGRAM_STATE_ENTER_SEARCH_FILTER_CASE_INSENSITIVE: {
-				SearchFilterInputCharacter(CurrentDirectoryEntriesBuffer, &CurrentDirectoryEntryCount, 
-				                           &SelectedIndex, &StartDrawIndex, ConsoleRows,
-				                           PathBuffer, FilterHiddenEntries, 
-				                           FilterBuffer, &FilterBufferIndex, FILTER_BUFFER_SIZE,
-				                           &ProgramState, InputCharacter, 0);
-			} break;
+			Event.Count -= RepeatCount;
 		}
 	}
 
 	// NOTE(Felix): Shutdown
 	ConsoleCleanup();
-	munmap(CurrentDirectoryEntriesBuffer, CurrentDirectoryEntriesBufferSize);
+	if (PrintFrameStats)
+	{
+		console_output *Output = &Screen->Output;
+		u64 FrameCount = MAX(Output->FrameCount, 1);
+		fprintf(stderr, "%" PFu64 " frames, per frame: %.1f us build, %.1f writes, %.1f bytes\n", Output->FrameCount,
+		        (f64)Output->TotalBuildNanoseconds / (f64)FrameCount / 1000.0,
+		        (f64)Output->TotalWriteCount / (f64)FrameCount,
+		        (f64)Output->TotalBytes / (f64)FrameCount);
+	}
+	if (PrintCacheStats)
+	{
+		directory_cache *Cache = &GLOBALDirectoryCache;
+		u32 CachedCount = 0;
+		for (u32 EntryIndex = 0; EntryIndex < DIRECTORY_CACHE_MAX_LISTINGS; ++EntryIndex)
+		{
+			CachedCount += (Cache->Entries[EntryIndex].IsUsed != 0);
+		}
+		fprintf(stderr, "directory cache: %" PFu64 " hits, %" PFu64 " misses, %" PFu32 " listings in %.1f MiB\n",
+		        Cache->HitCount, Cache->MissCount, CachedCount, (f64)Cache->MemorySize / (1024.0*1024.0));
+	}
+	DirectoryListingFree(&CurrentDirectoryListing);
 	return (0);
 }
@@ -29,17 +29,328 @@ typedef struct
 	ansi_color_code Foreground;
 } color;
 
+typedef enum
+{ 
+	ENTRY_TYPE_DIRECTORY,
+	ENTRY_TYPE_FILE,
+	ENTRY_TYPE_UNKNOWN, 
+} entry_type;
+
+enum
+{
+	ENTRY_FLAG_HIDDEN      = (1 << 0),
+	ENTRY_FLAG_STAT_CACHED  = (1 << 1), // Size, ModifiedTime, Mode and Owner are filled in
+	ENTRY_FLAG_STAT_FAILED  = (1 << 2),
+	ENTRY_FLAG_STAT_PENDING = (1 << 3), // Being fetched in the background, see stat_batch
+	ENTRY_FLAG_STAT_WANTED  = (1 << 4), // A query is waiting for it, see DirectoryListingStatRequestQuery
+};
+
+// NOTE(Felix): How the search term is matched against names
+typedef enum
+{
+	FILTER_MODE_SUBSTRING,
+	FILTER_MODE_FUZZY, // Ranked by score, see fuzzy_match.c
+	FILTER_MODE_PATTERN, // Glob or regular expression, see pattern_match.c
+	FILTER_MODE_QUERY, // Names and metadata, see metadata_query.c
+} filter_mode;
+
+typedef struct
+{
+	filter_mode Mode;
+	substring_matcher Substring;
+	fuzzy_pattern Fuzzy;
+	pattern_matcher *Pattern; // Only allocated once a pattern is used, see NameFilterRelease
+	metadata_query Query;
+} name_filter;
+
+// NOTE(Felix): What part of a listing is shown. Entries maps rows on screen to entries of the
+// listing. Every filter length gets its own level: level k holds all entries matching the first
+// k characters of Filter. Since a longer filter only ever narrows the result, typing filters the 
+// level below and backspace just drops back a level. Levels are stored back to back in 
+// LevelArena; a level that didn't remove anything shares the storage of the one below.
+// In fuzzy mode every level is ordered by score (best first) instead of like the listing.
+// A longer pattern doesn't narrow a shorter one ("*.c" vs "*.cc", "size<1" vs "size<10"), so
+// in pattern and query mode the levels below the top one just repeat level 0 and the top
+// level is filtered from level 0, see FilterModeNarrows.
+// Only levels below BuiltLevelCount are there, typing ahead can cancel building the rest
+// (see DirectoryViewFinish).
+// LevelArena only has room for a few levels as big as the listing (see
+// DIRECTORY_VIEW_LEVELS_SIZE_PER_ENTRY). If a level doesn't fit anymore, the levels below it
+// are dropped and it is filtered from level 0 instead, LevelsAreCollapsed says the levels in
+// between just repeat level 0 then and every edit has to filter again.
+// Queries never fetch metadata while filtering. Entries that haven't got theirs yet are left
+// out, MissingStatCount says how many the top level is waiting for. The metadata is fetched
+// in the background and the top level filtered again as it comes in, see
+// DirectoryViewQueryStatsUpdate
+#define DIRECTORY_VIEW_MAX_FILTER_LENGTH 256
+
+typedef struct
+{
+	u64 Offset;
+	u32 Count;
+	u64 ArenaEnd;
+} directory_view_level;
+
+typedef struct
+{
+	u32 *Entries;
+	u32 Count;
+
+	b32 HideHiddenEntries;
+	b32 FilterIsCaseSensitive;
+	filter_mode FilterMode;
+	char Filter[DIRECTORY_VIEW_MAX_FILTER_LENGTH];
+	u32 FilterLength;
+	b32 FilterIsInvalid; // Pattern or query that doesn't parse (yet), nothing is shown
+
+	directory_view_level Levels[DIRECTORY_VIEW_MAX_FILTER_LENGTH];
+	u32 BuiltLevelCount;
+	b32 LevelsAreCollapsed;
+	memory_arena LevelArena;
+
+	u32 MissingStatCount;
+	b32 WantedStatsArrived;
+	u64 LastQueryUpdateTime;
+} directory_view;
+
+// NOTE(Felix): Record layout of getdents64 (the kernel's struct linux_dirent64, 
+// which isn't exposed by any header)
+typedef struct
+{
+	u64 Inode;
+	i64 Offset;
+	u16 RecordLength;
+	u8 Type;
+	char Name[];
+} linux_dirent64;
+
+typedef struct
+{
+	i32 FileDescriptor;
+	u8 *Buffer;
+	u64 BufferFilled;
+	u64 BufferPosition;
+} directory_reader;
+
+// NOTE(Felix): Streaming keeps only a window of an (unsorted) directory in memory. 
+// A checkpoint remembers where to seek the directory to, so that the next entry we read
+// (that passes the filter) is entry number EntryIndex
+typedef struct
+{
+	u32 EntryIndex;
+	i64 Cookie;
+} directory_stream_checkpoint;
+
+typedef struct
+{
+	directory_stream_checkpoint *Checkpoints;
+	u32 CheckpointCount;
+	u32 CheckpointInterval;
+
+	u32 WindowStart;
+	u32 KnownCount;
+	b32 ReachedEnd;
+
+	// NOTE(Felix): Filter the stream was started with, every refill of the window needs it
+	b32 FilterHiddenEntries;
+	name_filter Filter;
+} directory_stream;
+
+typedef struct
+{
+	u64 Device;
+	u64 Inode;
+	i64 ModifiedTime; // Nanoseconds
+	i64 ChangeTime;
+} directory_identity;
+
+// NOTE(Felix): All entries of one directory. Names are packed back to back (zero terminated) 
+// into one buffer, everything else is stored in parallel arrays indexed by entry.
+// SortKey caches the first bytes of the name in an order preserving form, see SortKeyFromName.
+// CharMask records which characters show up in the name, see FuzzyCharMask.
+// Size, ModifiedTime, Mode and Owner are only fetched when a query needs them (see 
+// DirectoryListingStatGet) or the long listing shows them (see stat_batch), 
+// ENTRY_FLAG_STAT_CACHED says if they are there yet.
+// DirectoryFileDescriptor refers to the listed directory, metadata is fetched relative to it.
+// Generation changes whenever entries get other indices (reloading, sorting), so work that
+// started before can tell its entry indices are stale. Generations are unique across all
+// listings, since listings get moved in and out of the cache (see directory_cache).
+// Identity is what the directory looked like when it was opened, see DirectoryIdentityGet
+// Every array sits at the start of its own arena, so they can grow without moving.
+// The listing always holds every entry, what is shown is decided by View
+typedef struct
+{
+	char *Names;
+	u32 *NameOffset;
+	u8 *NameLength;
+	u8 *Type;
+	u8 *Flags;
+	u32 *SortKey;
+	u32 *CharMask;
+	u64 *Size;
+	i64 *ModifiedTime;
+	u32 *Mode;
+	u32 *Owner;
+	u32 Count;
+	u32 Capacity;
+	i32 DirectoryFileDescriptor;
+	u32 Generation;
+	directory_identity Identity;
+	b32 IdentityIsValid;
+
+	// NOTE(Felix): Progressive loading. While IsLoading is set the directory is still being
+	// read through Reader. Only the first Count entries are sorted (and shown), entries up 
+	// to LoadedCount have been read but not merged in yet. IsTruncated is set if the load
+	// stopped early because no more entries fit (see GLOBALListingMaxEntries)
+	b32 IsLoading;
+	b32 IsTruncated;
+	u32 LoadedCount;
+	u64 LastSortTime;
+	directory_reader Reader;
+
+	// NOTE(Felix): Streamed listings only hold a window of the directory, entry 0 is entry
+	// Stream.WindowStart of the directory (see DirectoryStreamFillWindow)
+	b32 IsStreamed;
+	directory_stream Stream;
+
+	directory_view View;
+
+	memory_arena NamesArena;
+	memory_arena NameOffsetArena;
+	memory_arena NameLengthArena;
+	memory_arena TypeArena;
+	memory_arena FlagsArena;
+	memory_arena SortKeyArena;
+	memory_arena CharMaskArena;
+	memory_arena SizeArena;
+	memory_arena ModifiedTimeArena;
+	memory_arena ModeArena;
+	memory_arena OwnerArena;
+} directory_listing;
+
+// NOTE(Felix): Long listing. The metadata of the rows on screen (and STAT_PREFETCH_ROWS on
+// either side) is fetched in the background, a batch of entries per job, the rest of the 
+// directory is never looked at. Entries of a batch are marked ENTRY_FLAG_STAT_PENDING and 
+// drawn with placeholders until it completes.
+// A batch copies the names it needs and gets its own descriptor of the directory, so it never
+// touches the listing on a worker. Results are only taken if the listing still has the same
+// Generation, batches that went stale or whose rows scrolled far away get cancelled.
+// A query fetches the same way: entries it needs metadata for are marked ENTRY_FLAG_STAT_WANTED
+// by the filter pass, batched regardless of what is on screen, and the view is filtered again
+// as they come in.
+// A batch goes to the kernel in one go through its own io_uring if that works (see
+// stat_ring.c), one statx after the other otherwise.
+// User names are looked up by the batch as well (that may have to ask NSS), the UI thread
+// only keeps them in a small cache, see OwnerNameGet
+#define STAT_BATCH_MAX_ENTRIES STAT_RING_ENTRIES
+#define STAT_BATCH_COUNT 8
+#define STAT_PREFETCH_ROWS 64
+#define OWNER_NAME_MAX_LENGTH 32
+#define OWNER_NAME_CACHE_SIZE 64
+
+typedef struct
+{
+	job Job;
+	b32 IsBusy; // Submitted and not completed yet
+	directory_listing *Listing;
+	u32 Generation;
+	i32 DirectoryFileDescriptor;
+	u32 FirstRow; // Rows of the view it was submitted for
+	u32 EndRow;
+	b32 IsForQuery; // For entries a query waits for instead, rows don't matter then
+
+	u32 Count;
+	u32 DoneCount; // A cancelled batch may stop early
+	u32 EntryIndex[STAT_BATCH_MAX_ENTRIES];
+	char Names[STAT_BATCH_MAX_ENTRIES][NAME_MAX+1];
+	entry_stat Stats[STAT_BATCH_MAX_ENTRIES];
+	b32 Fetched[STAT_BATCH_MAX_ENTRIES];
+	char OwnerNames[STAT_BATCH_MAX_ENTRIES][OWNER_NAME_MAX_LENGTH+1];
+
+	// NOTE(Felix): Set up the first time the batch is used
+	b32 RingIsSetUp;
+	b32 HasRing;
+	b32 UseRing;
+	stat_ring Ring;
+} stat_batch;
+
+typedef struct
+{
+	b32 IsUsed;
+	u32 Owner;
+	char Name[OWNER_NAME_MAX_LENGTH+1];
+} owner_name;
+
+// NOTE(Felix): Listings of directories we left, so going back (or bouncing between two
+// directories) costs an open and fstat instead of reading and sorting everything again.
+// Listings are looked up by device and inode, and only used if the modification and change
+// time of the directory are still what they were when it was read (adding, removing or
+// renaming entries changes those). Metadata of entries is fetched again, names and order
+// are kept.
+// This is the navigation history as well: every listing keeps its view (filter included)
+// and the selection and scroll position it was left with, so going back up shows each
+// level exactly like it was.
+// Least recently used listings are dropped once there are DIRECTORY_CACHE_MAX_LISTINGS of
+// them or together they take more than DIRECTORY_CACHE_MAX_MEMORY, the levels visited
+// longest ago go first. Streamed listings and ones that haven't finished loading aren't cached
+#define DIRECTORY_CACHE_MAX_LISTINGS 16
+#define DIRECTORY_CACHE_MAX_MEMORY MEBIBYTES(256)
+
+typedef struct
+{
+	b32 IsUsed;
+	u64 LastUsed;
+	u64 MemorySize;
+	i32 SelectedIndex;
+	i32 StartDrawIndex;
+	b32 IsPrefetched; // Read ahead of time and not visited yet, see directory_prefetch
+	directory_listing Listing;
+} directory_cache_entry;
+
+typedef struct
+{
+	directory_cache_entry Entries[DIRECTORY_CACHE_MAX_LISTINGS];
+	u64 UseCounter;
+	u64 MemorySize;
+	u64 HitCount;
+	u64 MissCount;
+} directory_cache;
+
+// NOTE(Felix): Speculative prefetch. Once the selection has rested on a directory for
+// DIRECTORY_PREFETCH_REST_MS it is read and sorted by a job, the finished listing goes into
+// the directory cache, so entering it afterwards just takes it out of there.
+// There is only ever one prefetch in flight, moving the selection cancels it (between two
+// getdents64 buffers) and the next one waits until it is done. Directories with more than
+// DIRECTORY_PREFETCH_MAX_ENTRIES entries are given up on, and the cache only ever holds one
+// prefetched listing that wasn't visited, so scrolling past directories doesn't push out the
+// ones we came from. Directories the cache holds already are skipped after an fstat.
+// The job only touches its own listing, it gets a copy of everything else it needs
+#define DIRECTORY_PREFETCH_REST_MS 50
+#define DIRECTORY_PREFETCH_MAX_ENTRIES 100000
+
 typedef struct
 {
-	char Name[256];
-	i32 NameLength;
-	//u64 Size;
-	enum { 
-		ENTRY_TYPE_DIRECTORY,
-		ENTRY_TYPE_FILE,
-		ENTRY_TYPE_UNKNOWN, 
-	} Type;
-} internal_directory_entry;
+	job Job;
+	b32 IsBusy;
+
+	// NOTE(Felix): What the selection rests on, since when, and if it has been prefetched
+	b32 HasTarget;
+	u32 ListingGeneration;
+	u32 EntryIndex;
+	u64 TargetSince;
+	b32 WasSubmitted;
+
+	// NOTE(Felix): Copied in for the job
+	char Path[PATH_MAX];
+	b32 HideHiddenEntries;
+	filter_mode FilterMode;
+	u32 CachedCount;
+	directory_identity Cached[DIRECTORY_CACHE_MAX_LISTINGS];
+
+	// NOTE(Felix): Set by the job
+	b32 IsReady;
+	directory_listing Listing;
+} directory_prefetch;
 
 typedef enum
 {
@@ -47,4 +358,7 @@ typedef enum
 	PROGRAM_STATE_AWAITING_JUMP_CHARACTER,
 	PROGRAM_STATE_ENTER_SEARCH_FILTER_CASE_SENSITIVE,
 	PROGRAM_STATE_ENTER_SEARCH_FILTER_CASE_INSENSITIVE,
+	PROGRAM_STATE_ENTER_SEARCH_FILTER_FUZZY,
+	PROGRAM_STATE_ENTER_SEARCH_FILTER_PATTERN,
+	PROGRAM_STATE_ENTER_SEARCH_FILTER_QUERY,
 } program_state;
@@ -0,0 +1,439 @@
+#pragma once
+
+// NOTE(Felix): Necessary includes
+// "language_layer.h"
+// "string_match.c"
+#include <sys/syscall.h>
+#include <sys/stat.h>
+#include <linux/stat.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdio.h>
+
+// NOTE(Felix): Metadata queries, a filter like "size>1G mtime<1h type=f perm=x log".
+// Space separated terms, all of them have to match:
+//  size<op><number>[k|m|g|t]   size in bytes (suffixes are powers of 1024, either case)
+//  mtime<op><number>[s|m|h|d|w] age since the last modification ("mtime<1h": changed within the last hour)
+//  type=f, type=d              file or directory (also "!=")
+//  perm=rwx                    the owner has (all of) these permissions (also "!=")
+//  perm=<octal>                permission bits are exactly this (like "perm=644")
+//  anything else               has to be part of the name (smart case, like fuzzy search)
+// <op> is one of < <= = != >= >
+//
+// A query is compiled into a short predicate program. Everything that can be answered from
+// the name and the directory entry itself comes first, predicates that need statx come last,
+// so metadata is only fetched for entries that made it that far (and a query without them
+// never fetches anything). Callers fetch it in the background and cache it, see
+// DirectoryListingStatRequestQuery.
+#define QUERY_MAX_NAME_TERMS 8
+#define QUERY_MAX_PREDICATES 32
+
+typedef struct
+{
+	u64 Size;
+	i64 ModifiedTime; // Seconds since the epoch
+	u32 Mode;         // File type and permission bits, like st_mode
+	u32 Owner;        // User id
+} entry_stat;
+
+typedef enum
+{
+	QUERY_PREDICATE_TYPE,        // Value is 'd' or 'f'
+	QUERY_PREDICATE_SIZE,
+	QUERY_PREDICATE_AGE,         // Seconds since the last modification
+	QUERY_PREDICATE_PERMISSIONS, // Value is a mask of owner permission bits that all have to be set
+	QUERY_PREDICATE_MODE,        // Value is the exact set of permission bits
+} query_predicate_kind;
+
+typedef enum
+{
+	QUERY_COMPARE_LESS,
+	QUERY_COMPARE_LESS_EQUAL,
+	QUERY_COMPARE_EQUAL,
+	QUERY_COMPARE_NOT_EQUAL,
+	QUERY_COMPARE_GREATER_EQUAL,
+	QUERY_COMPARE_GREATER,
+} query_compare;
+
+typedef struct
+{
+	query_predicate_kind Kind;
+	query_compare Compare;
+	i64 Value;
+} query_predicate;
+
+typedef struct
+{
+	b32 IsValid;
+	i64 Now;
+
+	substring_matcher NameTerms[QUERY_MAX_NAME_TERMS];
+	u32 NameTermCount;
+
+	// NOTE(Felix): Predicates before StatStart don't need statx
+	query_predicate Program[QUERY_MAX_PREDICATES];
+	u32 PredicateCount;
+	u32 StatStart;
+} metadata_query;
+
+internal b32
+EntryStatFetch(entry_stat *Stat, i32 DirectoryFileDescriptor, char *Name)
+{
+	// NOTE(Felix): Straight statx syscall, only asks for what queries and the long listing 
+	// can look at
+	struct statx Buffer;
+	long Error = syscall(SYS_statx, DirectoryFileDescriptor, Name, AT_SYMLINK_NOFOLLOW,
+	                     STATX_TYPE | STATX_MODE | STATX_SIZE | STATX_MTIME | STATX_UID, &Buffer);
+	if (Error != 0)
+	{
+		return (0);
+	}
+	Stat->Size = Buffer.stx_size;
+	Stat->ModifiedTime = Buffer.stx_mtime.tv_sec;
+	Stat->Mode = Buffer.stx_mode;
+	Stat->Owner = Buffer.stx_uid;
+	return (1);
+}
+
+internal void
+EntryModeFormat(u32 Mode, char *Buffer)
+{
+	// NOTE(Felix): Like "ls -l", "drwxr-xr-x". Buffer has to hold 11 characters
+	char Type = '-';
+	if      (S_ISDIR(Mode))  { Type = 'd'; }
+	else if (S_ISLNK(Mode))  { Type = 'l'; }
+	else if (S_ISCHR(Mode))  { Type = 'c'; }
+	else if (S_ISBLK(Mode))  { Type = 'b'; }
+	else if (S_ISFIFO(Mode)) { Type = 'p'; }
+	else if (S_ISSOCK(Mode)) { Type = 's'; }
+	Buffer[0] = Type;
+
+	char *Letters = "rwxrwxrwx";
+	for (u32 Index = 0; Index < 9; ++Index)
+	{
+		Buffer[1+Index] = (Mode & (1u << (8-Index))) ? Letters[Index] : '-';
+	}
+	if (Mode & S_ISUID) { Buffer[3] = (Mode & S_IXUSR) ? 's' : 'S'; }
+	if (Mode & S_ISGID) { Buffer[6] = (Mode & S_IXGRP) ? 's' : 'S'; }
+	if (Mode & S_ISVTX) { Buffer[9] = (Mode & S_IXOTH) ? 't' : 'T'; }
+	Buffer[10] = 0;
+}
+
+internal void
+EntrySizeFormat(u64 Size, char *Buffer, u32 BufferSize)
+{
+	// NOTE(Felix): Like "ls -h", "912", "4.0K", "17M"
+	if (Size < 1024)
+	{
+		snprintf(Buffer, BufferSize, "%" PFu64, Size);
+		return;
+	}
+
+	char *Units = "KMGTPE";
+	u32 Unit = 0;
+	f64 Value = (f64)Size / 1024.0;
+	while (Value >= 1024.0 && Units[Unit+1])
+	{
+		Value /= 1024.0;
+		++Unit;
+	}
+	snprintf(Buffer, BufferSize, (Value < 10.0) ? "%.1f%c" : "%.0f%c", Value, Units[Unit]);
+}
+
+internal void
+EntryTimeFormat(i64 Time, i64 Now, char *Buffer, u32 BufferSize)
+{
+	// NOTE(Felix): Like "ls -l", the time of day for the last half year and the year otherwise.
+	// Always 12 characters
+	struct tm Local = { 0 };
+	time_t Seconds = (time_t)Time;
+	localtime_r(&Seconds, &Local);
+	i64 HalfYear = (365*24*60*60) / 2;
+	b32 IsRecent = (Time > Now - HalfYear && Time < Now + 60*60);
+	strftime(Buffer, BufferSize, IsRecent ? "%b %e %H:%M" : "%b %e  %Y", &Local);
+}
+
+internal b32
+QueryCompareValues(i64 Left, query_compare Compare, i64 Right)
+{
+	b32 Result = 0;
+	switch (Compare)
+	{
+		case QUERY_COMPARE_LESS:          { Result = (Left <  Right); } break;
+		case QUERY_COMPARE_LESS_EQUAL:    { Result = (Left <= Right); } break;
+		case QUERY_COMPARE_EQUAL:         { Result = (Left == Right); } break;
+		case QUERY_COMPARE_NOT_EQUAL:     { Result = (Left != Right); } break;
+		case QUERY_COMPARE_GREATER_EQUAL: { Result = (Left >= Right); } break;
+		case QUERY_COMPARE_GREATER:       { Result = (Left >  Right); } break;
+	}
+	return (Result);
+}
+
+internal b32
+QueryParseCompare(char **Cursor, query_compare *Compare)
+{
+	char *At = *Cursor;
+	b32 Result = 1;
+	if      (At[0] == '<' && At[1] == '=') { *Compare = QUERY_COMPARE_LESS_EQUAL;    At += 2; }
+	else if (At[0] == '>' && At[1] == '=') { *Compare = QUERY_COMPARE_GREATER_EQUAL; At += 2; }
+	else if (At[0] == '!' && At[1] == '=') { *Compare = QUERY_COMPARE_NOT_EQUAL;     At += 2; }
+	else if (At[0] == '<')                 { *Compare = QUERY_COMPARE_LESS;          At += 1; }
+	else if (At[0] == '>')                 { *Compare = QUERY_COMPARE_GREATER;       At += 1; }
+	else if (At[0] == '=')                 { *Compare = QUERY_COMPARE_EQUAL;         At += 1; }
+	else                                   { Result = 0; }
+	*Cursor = At;
+	return (Result);
+}
+
+internal b32
+QueryParseNumber(char *Value, u32 Length, char *Suffixes, i64 *Multipliers, i64 *Result)
+{
+	// NOTE(Felix): Digits followed by at most one of Suffixes (case insensitive)
+	u32 Index = 0;
+	i64 Number = 0;
+	for (; Index < Length && CharIsDigit(Value[Index]); ++Index)
+	{
+		if (Number > (0x7fffffffffffffffll - 9) / 10)
+		{
+			return (0);
+		}
+		Number = Number*10 + (Value[Index] - '0');
+	}
+	if (Index == 0)
+	{
+		return (0);
+	}
+
+	i64 Multiplier = 1;
+	if (Index < Length)
+	{
+		b32 Found = 0;
+		for (u32 SuffixIndex = 0; Suffixes[SuffixIndex] && 0 == Found; ++SuffixIndex)
+		{
+			if (CharToLowerIfIsLetter(Value[Index]) == Suffixes[SuffixIndex])
+			{
+				Multiplier = Multipliers[SuffixIndex];
+				Found = 1;
+			}
+		}
+		if (0 == Found || Index+1 != Length || Number > 0x7fffffffffffffffll / Multiplier)
+		{
+			return (0);
+		}
+	}
+	*Result = Number*Multiplier;
+	return (1);
+}
+
+internal b32
+QueryParsePredicate(char *Term, u32 Length, query_predicate *Predicate, b32 *IsPredicate)
+{
+	// NOTE(Felix): A term is a predicate if it starts with a key and a comparison,
+	// otherwise it's a name term. Returns 0 for predicates that don't parse (yet)
+	local_persist char *Keys[] = { "size", "mtime", "type", "perm" };
+	*IsPredicate = 0;
+	for (u32 KeyIndex = 0; KeyIndex < ARRAYCOUNT(Keys) && 0 == *IsPredicate; ++KeyIndex)
+	{
+		u32 KeyLength = StringLength(Keys[KeyIndex]);
+		char *Cursor = Term + KeyLength;
+		if (Length <= KeyLength || 0 == StringStartsWith(Term, Keys[KeyIndex]) ||
+		    0 == QueryParseCompare(&Cursor, &Predicate->Compare))
+		{
+			continue;
+		}
+		*IsPredicate = 1;
+
+		char *Value = Cursor;
+		u32 ValueLength = Length - (u32)(Cursor - Term);
+		b32 IsEquality = (Predicate->Compare == QUERY_COMPARE_EQUAL || Predicate->Compare == QUERY_COMPARE_NOT_EQUAL);
+		switch (KeyIndex)
+		{
+			case 0: {
+				local_persist i64 SizeMultipliers[] = { 1ll << 10, 1ll << 20, 1ll << 30, 1ll << 40 };
+				Predicate->Kind = QUERY_PREDICATE_SIZE;
+				return (QueryParseNumber(Value, ValueLength, "kmgt", SizeMultipliers, &Predicate->Value));
+			} break;
+
+			case 1: {
+				local_persist i64 TimeMultipliers[] = { 1, 60, 60*60, 24*60*60, 7*24*60*60 };
+				Predicate->Kind = QUERY_PREDICATE_AGE;
+				return (QueryParseNumber(Value, ValueLength, "smhdw", TimeMultipliers, &Predicate->Value));
+			} break;
+
+			case 2: {
+				Predicate->Kind = QUERY_PREDICATE_TYPE;
+				Predicate->Value = Value[0];
+				return (IsEquality && ValueLength == 1 && (Value[0] == 'f' || Value[0] == 'd'));
+			} break;
+
+			case 3: {
+				if (0 == IsEquality || ValueLength == 0)
+				{
+					return (0);
+				}
+				Predicate->Kind = CharIsDigit(Value[0]) ? QUERY_PREDICATE_MODE : QUERY_PREDICATE_PERMISSIONS;
+				Predicate->Value = 0;
+				for (u32 Index = 0; Index < ValueLength; ++Index)
+				{
+					char Char = Value[Index];
+					if (Predicate->Kind == QUERY_PREDICATE_MODE && Char >= '0' && Char <= '7' && Index < 4)
+					{
+						Predicate->Value = Predicate->Value*8 + (Char - '0');
+					}
+					else if (Predicate->Kind == QUERY_PREDICATE_PERMISSIONS && Char == 'r') { Predicate->Value |= S_IRUSR; }
+					else if (Predicate->Kind == QUERY_PREDICATE_PERMISSIONS && Char == 'w') { Predicate->Value |= S_IWUSR; }
+					else if (Predicate->Kind == QUERY_PREDICATE_PERMISSIONS && Char == 'x') { Predicate->Value |= S_IXUSR; }
+					else
+					{
+						return (0);
+					}
+				}
+				return (1);
+			} break;
+		}
+	}
+	return (1);
+}
+
+internal void
+QueryCompile(metadata_query *Query, char *Text)
+{
+	Query->IsValid = 1;
+	Query->NameTermCount = 0;
+	Query->PredicateCount = 0;
+
+	struct timespec Time = { 0 };
+	clock_gettime(CLOCK_REALTIME, &Time);
+	Query->Now = Time.tv_sec;
+
+	query_predicate StatPredicates[QUERY_MAX_PREDICATES];
+	u32 StatPredicateCount = 0;
+	char *At = Text;
+	while (*At)
+	{
+		while (*At == ' ') { ++At; }
+		char *Term = At;
+		while (*At && *At != ' ') { ++At; }
+		u32 Length = (u32)(At - Term);
+		if (Length == 0)
+		{
+			break;
+		}
+
+		query_predicate Predicate = { 0 };
+		b32 IsPredicate = 0;
+		if (0 == QueryParsePredicate(Term, Length, &Predicate, &IsPredicate) ||
+		    Query->PredicateCount + StatPredicateCount == QUERY_MAX_PREDICATES)
+		{
+			Query->IsValid = 0;
+		}
+		else if (IsPredicate && Predicate.Kind == QUERY_PREDICATE_TYPE)
+		{
+			Query->Program[Query->PredicateCount++] = Predicate;
+		}
+		else if (IsPredicate)
+		{
+			StatPredicates[StatPredicateCount++] = Predicate;
+		}
+		else if (Query->NameTermCount < QUERY_MAX_NAME_TERMS)
+		{
+			char TermBuffer[STRING_MATCH_MAX_TERM_LENGTH];
+			Length = MIN(Length, STRING_MATCH_MAX_TERM_LENGTH-1);
+			MemoryCopy(TermBuffer, Term, Length);
+			TermBuffer[Length] = 0;
+			b32 IsCaseSensitive = 0;
+			for (u32 Index = 0; Index < Length; ++Index)
+			{
+				IsCaseSensitive |= (Term[Index] >= 'A' && Term[Index] <= 'Z');
+			}
+			SubstringMatcherInit(&Query->NameTerms[Query->NameTermCount++], TermBuffer, IsCaseSensitive);
+		}
+		else
+		{
+			Query->IsValid = 0;
+		}
+	}
+
+	Query->StatStart = Query->PredicateCount;
+	for (u32 Index = 0; Index < StatPredicateCount; ++Index)
+	{
+		Query->Program[Query->PredicateCount++] = StatPredicates[Index];
+	}
+}
+
+internal b32
+QueryNeedsStat(metadata_query *Query)
+{
+	return (Query->StatStart < Query->PredicateCount);
+}
+
+internal b32
+QueryMatchName(metadata_query *Query, char *Name, u32 NameLength)
+{
+	// NOTE(Felix): Name needs STRING_MATCH_READ_PADDING readable bytes behind it
+	if (0 == Query->IsValid)
+	{
+		return (0);
+	}
+	for (u32 Index = 0; Index < Query->NameTermCount; ++Index)
+	{
+		if (0 == SubstringMatch(&Query->NameTerms[Index], Name, NameLength))
+		{
+			return (0);
+		}
+	}
+	return (1);
+}
+
+internal b32
+QueryRun(metadata_query *Query, u32 First, u32 End, b32 IsDirectory, entry_stat *Stat)
+{
+	// NOTE(Felix): Stat is only looked at (and may be 0 for) predicates from StatStart on
+	for (u32 Index = First; Index < End; ++Index)
+	{
+		query_predicate *Predicate = &Query->Program[Index];
+		i64 Value = 0;
+		switch (Predicate->Kind)
+		{
+			case QUERY_PREDICATE_TYPE: {
+				Value = IsDirectory ? 'd' : 'f';
+			} break;
+
+			case QUERY_PREDICATE_SIZE: {
+				Value = (i64)Stat->Size;
+			} break;
+
+			case QUERY_PREDICATE_AGE: {
+				Value = Query->Now - Stat->ModifiedTime;
+			} break;
+
+			case QUERY_PREDICATE_PERMISSIONS: {
+				// NOTE(Felix): Equal if all of the bits are set
+				Value = Stat->Mode & Predicate->Value;
+			} break;
+
+			case QUERY_PREDICATE_MODE: {
+				Value = Stat->Mode & 07777;
+			} break;
+		}
+		if (0 == QueryCompareValues(Value, Predicate->Compare, Predicate->Value))
+		{
+			return (0);
+		}
+	}
+	return (1);
+}
+
+internal b32
+QueryMatchEntry(metadata_query *Query, b32 IsDirectory)
+{
+	// NOTE(Felix): The part of the program that only needs the directory entry
+	return (QueryRun(Query, 0, Query->StatStart, IsDirectory, 0));
+}
+
+internal b32
+QueryMatchStat(metadata_query *Query, b32 IsDirectory, entry_stat *Stat)
+{
+	return (QueryRun(Query, Query->StatStart, Query->PredicateCount, IsDirectory, Stat));
+}
@@ -0,0 +1,769 @@
+#pragma once
+
+// NOTE(Felix): Necessary includes
+// "language_layer.h"
+#include <sys/mman.h>
+
+// NOTE(Felix): Pattern matching for the filter. A pattern is a glob that has to match the
+// whole name, unless it starts with '^', then it is a regular expression (anchored at the
+// start, and at the end only if it ends with '$').
+//  Glob:  *  ?  [abc]  [a-z]  [!a-z] (or [^a-z])  \x
+//  Regex: .  [...]  *  +  ?  |  ( )  \x  and '$' at the end
+// Case insensitive unless the pattern has an upper case letter (smart case).
+//
+// The pattern is parsed into an NFA once (Thompson construction). Bytes the pattern can't
+// tell apart share a byte class. Matching runs a DFA whose states (sets of NFA states) and
+// transitions are only worked out the first time they're needed, then they're kept for
+// every following name. Once warmed up a byte costs one table lookup, a missing transition
+// at most one pass over the NFA. If the DFA table fills up it's flushed and rebuilt on the
+// go, so even patterns whose full DFA would explode never cost more than that per byte and
+// nothing ever backtracks. If it keeps getting flushed the cache doesn't pay off, then the
+// remaining names are matched by stepping the NFA state sets directly.
+// To keep a step cheap, the closure behind every NFA state and the NFA states accepting
+// every byte class are bit sets worked out up front, a step is then just a few ANDs and ORs.
+#define PATTERN_MAX_NFA_STATES 1024
+#define PATTERN_MAX_DFA_STATES 1024
+#define PATTERN_NFA_SET_WORDS (PATTERN_MAX_NFA_STATES/64)
+#define PATTERN_NONE 0xffff
+#define PATTERN_DFA_UNKNOWN 0xffff
+#define PATTERN_DFA_DEAD 0
+#define PATTERN_DFA_START 1
+#define PATTERN_MAX_DFA_FLUSHES 8
+
+typedef enum
+{
+	PATTERN_NFA_CHARS, // Consumes one byte out of Chars, continues at Out[0]
+	PATTERN_NFA_SPLIT, // Continues at Out[0] and Out[1]
+	PATTERN_NFA_EMPTY, // Continues at Out[0]
+	PATTERN_NFA_MATCH,
+} pattern_nfa_kind;
+
+typedef struct
+{
+	u8 Kind;
+	u16 Out[2];
+	u8 Chars[32];
+} pattern_nfa_state;
+
+// NOTE(Felix): Out slots that still have to be connected are kept in a list that is linked
+// through the slots themselves. A slot is State*2 + Index
+typedef struct
+{
+	u32 Start;
+	u32 Dangling;
+} pattern_fragment;
+
+typedef struct
+{
+	b32 IsValid;
+	b32 AnchoredEnd;
+	b32 IsCaseSensitive;
+
+	char *Source;
+	u32 SourceLength;
+	u32 Position;
+
+	pattern_nfa_state Nfa[PATTERN_MAX_NFA_STATES];
+	u32 NfaCount;
+	u32 NfaStart;
+	u32 NfaMatch;
+	u32 NfaSetWords; // Words of a set actually in use
+	u64 NfaFollow[PATTERN_MAX_NFA_STATES][PATTERN_NFA_SET_WORDS]; // Closure after consuming a byte
+
+	u8 ByteClass[256];
+	u32 ClassCount;
+	u64 ClassAccepts[256][PATTERN_NFA_SET_WORDS];
+
+	u32 DfaCount;
+	u32 DfaFlushCount;
+	u64 DfaSets[PATTERN_MAX_DFA_STATES][PATTERN_NFA_SET_WORDS];
+	u8 DfaIsMatch[PATTERN_MAX_DFA_STATES];
+	u16 DfaHash[2*PATTERN_MAX_DFA_STATES];
+	u16 Transitions[PATTERN_MAX_DFA_STATES*256];
+} pattern_matcher;
+
+internal pattern_matcher *
+PatternMatcherAllocate(void)
+{
+	pattern_matcher *Result = mmap(0, sizeof(pattern_matcher), PROT_READ|PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	Assert(Result != MAP_FAILED);
+	return (Result);
+}
+
+internal void
+PatternMatcherFree(pattern_matcher *Matcher)
+{
+	munmap(Matcher, sizeof(pattern_matcher));
+}
+
+// NOTE(Felix): NFA construction
+
+internal u16 *
+PatternSlot(pattern_matcher *Matcher, u32 Slot)
+{
+	return (&Matcher->Nfa[Slot >> 1].Out[Slot & 1]);
+}
+
+internal void
+PatternPatch(pattern_matcher *Matcher, u32 List, u32 Target)
+{
+	while (List != PATTERN_NONE)
+	{
+		u16 *Slot = PatternSlot(Matcher, List);
+		List = *Slot;
+		*Slot = (u16)Target;
+	}
+}
+
+internal u32
+PatternAppend(pattern_matcher *Matcher, u32 ListA, u32 ListB)
+{
+	if (ListA == PATTERN_NONE)
+	{
+		return (ListB);
+	}
+	u32 Last = ListA;
+	while (*PatternSlot(Matcher, Last) != PATTERN_NONE)
+	{
+		Last = *PatternSlot(Matcher, Last);
+	}
+	*PatternSlot(Matcher, Last) = (u16)ListB;
+	return (ListA);
+}
+
+internal u32
+PatternNfaAdd(pattern_matcher *Matcher, pattern_nfa_kind Kind)
+{
+	// NOTE(Felix): Running out of states makes the pattern invalid, state 0 is handed out
+	// anyway so the caller doesn't have to check
+	if (Matcher->NfaCount == PATTERN_MAX_NFA_STATES)
+	{
+		Matcher->IsValid = 0;
+		return (0);
+	}
+	u32 State = Matcher->NfaCount++;
+	MemoryClear(&Matcher->Nfa[State], sizeof(Matcher->Nfa[State]));
+	Matcher->Nfa[State].Kind = (u8)Kind;
+	Matcher->Nfa[State].Out[0] = PATTERN_NONE;
+	Matcher->Nfa[State].Out[1] = PATTERN_NONE;
+	return (State);
+}
+
+internal void
+PatternCharsAdd(pattern_matcher *Matcher, u8 *Chars, u8 Char)
+{
+	Chars[Char >> 3] |= (u8)(1u << (Char & 7));
+	if (0 == Matcher->IsCaseSensitive && CharIsLetter((char)Char))
+	{
+		u8 OtherCase = (u8)(Char ^ 0x20);
+		Chars[OtherCase >> 3] |= (u8)(1u << (OtherCase & 7));
+	}
+}
+
+internal b32
+PatternCharsContain(u8 *Chars, u8 Char)
+{
+	return ((Chars[Char >> 3] >> (Char & 7)) & 1);
+}
+
+internal pattern_fragment
+PatternFragmentChars(pattern_matcher *Matcher, u32 *StateOut)
+{
+	u32 State = PatternNfaAdd(Matcher, PATTERN_NFA_CHARS);
+	pattern_fragment Result = { State, State*2 };
+	*StateOut = State;
+	return (Result);
+}
+
+internal pattern_fragment
+PatternFragmentLiteral(pattern_matcher *Matcher, u8 Char)
+{
+	u32 State = 0;
+	pattern_fragment Result = PatternFragmentChars(Matcher, &State);
+	PatternCharsAdd(Matcher, Matcher->Nfa[State].Chars, Char);
+	return (Result);
+}
+
+internal pattern_fragment
+PatternFragmentAny(pattern_matcher *Matcher)
+{
+	u32 State = 0;
+	pattern_fragment Result = PatternFragmentChars(Matcher, &State);
+	for (u32 Index = 0; Index < 32; ++Index)
+	{
+		Matcher->Nfa[State].Chars[Index] = 0xff;
+	}
+	return (Result);
+}
+
+internal pattern_fragment
+PatternFragmentEmpty(pattern_matcher *Matcher)
+{
+	u32 State = PatternNfaAdd(Matcher, PATTERN_NFA_EMPTY);
+	pattern_fragment Result = { State, State*2 };
+	return (Result);
+}
+
+internal pattern_fragment
+PatternFragmentConcat(pattern_matcher *Matcher, pattern_fragment A, pattern_fragment B)
+{
+	PatternPatch(Matcher, A.Dangling, B.Start);
+	pattern_fragment Result = { A.Start, B.Dangling };
+	return (Result);
+}
+
+internal pattern_fragment
+PatternFragmentAlternate(pattern_matcher *Matcher, pattern_fragment A, pattern_fragment B)
+{
+	u32 State = PatternNfaAdd(Matcher, PATTERN_NFA_SPLIT);
+	Matcher->Nfa[State].Out[0] = (u16)A.Start;
+	Matcher->Nfa[State].Out[1] = (u16)B.Start;
+	pattern_fragment Result = { State, PatternAppend(Matcher, A.Dangling, B.Dangling) };
+	return (Result);
+}
+
+internal pattern_fragment
+PatternFragmentRepeat(pattern_matcher *Matcher, pattern_fragment A, char Operator)
+{
+	// NOTE(Felix): '*' zero or more, '+' one or more, '?' zero or one
+	u32 State = PatternNfaAdd(Matcher, PATTERN_NFA_SPLIT);
+	Matcher->Nfa[State].Out[0] = (u16)A.Start;
+	pattern_fragment Result = { State, State*2 + 1 };
+	if (Operator == '?')
+	{
+		Result.Dangling = PatternAppend(Matcher, A.Dangling, State*2 + 1);
+	}
+	else
+	{
+		PatternPatch(Matcher, A.Dangling, State);
+		if (Operator == '+')
+		{
+			Result.Start = A.Start;
+		}
+	}
+	return (Result);
+}
+
+// NOTE(Felix): Parsing
+
+internal b32
+PatternAtEnd(pattern_matcher *Matcher)
+{
+	return (Matcher->Position >= Matcher->SourceLength);
+}
+
+internal u8
+PatternPeek(pattern_matcher *Matcher)
+{
+	return ((u8)Matcher->Source[Matcher->Position]);
+}
+
+internal pattern_fragment
+PatternParseClass(pattern_matcher *Matcher, b32 IsGlob)
+{
+	// NOTE(Felix): Position is right behind the '['. Without a closing ']' the '[' is
+	// taken literally (like shells do)
+	u32 OpeningPosition = Matcher->Position;
+	u8 Chars[32] = { 0 };
+	b32 Negate = 0;
+	if (0 == PatternAtEnd(Matcher) &&
+	    (PatternPeek(Matcher) == '^' || (IsGlob && PatternPeek(Matcher) == '!')))
+	{
+		Negate = 1;
+		++Matcher->Position;
+	}
+
+	b32 First = 1;
+	b32 Closed = 0;
+	while (0 == PatternAtEnd(Matcher))
+	{
+		u8 Char = PatternPeek(Matcher);
+		++Matcher->Position;
+		if (Char == ']' && 0 == First)
+		{
+			Closed = 1;
+			break;
+		}
+		if (Char == '\\' && 0 == PatternAtEnd(Matcher))
+		{
+			Char = PatternPeek(Matcher);
+			++Matcher->Position;
+		}
+
+		u8 Last = Char;
+		if (Matcher->Position+1 < Matcher->SourceLength &&
+		    PatternPeek(Matcher) == '-' && Matcher->Source[Matcher->Position+1] != ']')
+		{
+			Last = (u8)Matcher->Source[Matcher->Position+1];
+			Matcher->Position += 2;
+		}
+		for (u32 Range = Char; Range <= Last; ++Range)
+		{
+			PatternCharsAdd(Matcher, Chars, (u8)Range);
+		}
+		First = 0;
+	}
+
+	if (0 == Closed)
+	{
+		Matcher->Position = OpeningPosition;
+		return (PatternFragmentLiteral(Matcher, '['));
+	}
+
+	u32 State = 0;
+	pattern_fragment Result = PatternFragmentChars(Matcher, &State);
+	for (u32 Index = 0; Index < 32; ++Index)
+	{
+		Matcher->Nfa[State].Chars[Index] = Negate ? (u8)~Chars[Index] : Chars[Index];
+	}
+	return (Result);
+}
+
+internal pattern_fragment PatternParseAlternation(pattern_matcher *Matcher);
+
+internal pattern_fragment
+PatternParseAtom(pattern_matcher *Matcher)
+{
+	u8 Char = PatternPeek(Matcher);
+	++Matcher->Position;
+	pattern_fragment Result = { 0 };
+	switch (Char)
+	{
+		case '(': {
+			Result = PatternParseAlternation(Matcher);
+			if (PatternAtEnd(Matcher) || PatternPeek(Matcher) != ')')
+			{
+				Matcher->IsValid = 0;
+			}
+			++Matcher->Position;
+		} break;
+
+		case '[': {
+			Result = PatternParseClass(Matcher, 0);
+		} break;
+
+		case '.': {
+			Result = PatternFragmentAny(Matcher);
+		} break;
+
+		case '\\': {
+			if (0 == PatternAtEnd(Matcher))
+			{
+				Char = PatternPeek(Matcher);
+				++Matcher->Position;
+			}
+			Result = PatternFragmentLiteral(Matcher, Char);
+		} break;
+
+		default: {
+			Result = PatternFragmentLiteral(Matcher, Char);
+		} break;
+	}
+	return (Result);
+}
+
+internal pattern_fragment
+PatternParseConcatenation(pattern_matcher *Matcher)
+{
+	pattern_fragment Result = { 0 };
+	b32 HasFragment = 0;
+	while (0 == PatternAtEnd(Matcher) && PatternPeek(Matcher) != '|' && PatternPeek(Matcher) != ')')
+	{
+		// NOTE(Felix): '$' only means something at the very end
+		if (PatternPeek(Matcher) == '$' && Matcher->Position+1 == Matcher->SourceLength)
+		{
+			Matcher->AnchoredEnd = 1;
+			++Matcher->Position;
+			break;
+		}
+
+		pattern_fragment Fragment = PatternParseAtom(Matcher);
+		while (0 == PatternAtEnd(Matcher) &&
+		       (PatternPeek(Matcher) == '*' || PatternPeek(Matcher) == '+' || PatternPeek(Matcher) == '?'))
+		{
+			Fragment = PatternFragmentRepeat(Matcher, Fragment, (char)PatternPeek(Matcher));
+			++Matcher->Position;
+		}
+		Result = HasFragment ? PatternFragmentConcat(Matcher, Result, Fragment) : Fragment;
+		HasFragment = 1;
+	}
+	if (0 == HasFragment)
+	{
+		Result = PatternFragmentEmpty(Matcher);
+	}
+	return (Result);
+}
+
+internal pattern_fragment
+PatternParseAlternation(pattern_matcher *Matcher)
+{
+	pattern_fragment Result = PatternParseConcatenation(Matcher);
+	while (0 == PatternAtEnd(Matcher) && PatternPeek(Matcher) == '|')
+	{
+		++Matcher->Position;
+		Result = PatternFragmentAlternate(Matcher, Result, PatternParseConcatenation(Matcher));
+	}
+	return (Result);
+}
+
+internal pattern_fragment
+PatternParseGlob(pattern_matcher *Matcher)
+{
+	pattern_fragment Result = PatternFragmentEmpty(Matcher);
+	while (0 == PatternAtEnd(Matcher))
+	{
+		u8 Char = PatternPeek(Matcher);
+		++Matcher->Position;
+		pattern_fragment Fragment = { 0 };
+		switch (Char)
+		{
+			case '*': {
+				Fragment = PatternFragmentRepeat(Matcher, PatternFragmentAny(Matcher), '*');
+			} break;
+
+			case '?': {
+				Fragment = PatternFragmentAny(Matcher);
+			} break;
+
+			case '[': {
+				Fragment = PatternParseClass(Matcher, 1);
+			} break;
+
+			case '\\': {
+				if (0 == PatternAtEnd(Matcher))
+				{
+					Char = PatternPeek(Matcher);
+					++Matcher->Position;
+				}
+				Fragment = PatternFragmentLiteral(Matcher, Char);
+			} break;
+
+			default: {
+				Fragment = PatternFragmentLiteral(Matcher, Char);
+			} break;
+		}
+		Result = PatternFragmentConcat(Matcher, Result, Fragment);
+	}
+	return (Result);
+}
+
+internal void
+PatternComputeByteClasses(pattern_matcher *Matcher)
+{
+	// NOTE(Felix): Starts with all bytes in one class, every character set of the NFA
+	// splits the classes into the part inside and the part outside of the set
+	MemoryClear(Matcher->ByteClass, sizeof(Matcher->ByteClass));
+	Matcher->ClassCount = 1;
+	for (u32 State = 0; State < Matcher->NfaCount; ++State)
+	{
+		if (Matcher->Nfa[State].Kind != PATTERN_NFA_CHARS)
+		{
+			continue;
+		}
+
+		u16 NewClassInside[256];
+		u16 NewClassOutside[256];
+		for (u32 Class = 0; Class < 256; ++Class)
+		{
+			NewClassInside[Class] = PATTERN_NONE;
+			NewClassOutside[Class] = PATTERN_NONE;
+		}
+		u32 NewClassCount = 0;
+		for (u32 Byte = 0; Byte < 256; ++Byte)
+		{
+			u8 OldClass = Matcher->ByteClass[Byte];
+			u16 *NewClass = PatternCharsContain(Matcher->Nfa[State].Chars, (u8)Byte) ? NewClassInside : NewClassOutside;
+			if (NewClass[OldClass] == PATTERN_NONE)
+			{
+				NewClass[OldClass] = (u16)NewClassCount++;
+			}
+			Matcher->ByteClass[Byte] = (u8)NewClass[OldClass];
+		}
+		Matcher->ClassCount = NewClassCount;
+	}
+}
+
+// NOTE(Felix): DFA
+
+internal void
+PatternAddClosure(pattern_matcher *Matcher, u64 *Set, u32 State)
+{
+	u16 Stack[2*PATTERN_MAX_NFA_STATES];
+	u32 StackCount = 0;
+	Stack[StackCount++] = (u16)State;
+	while (StackCount > 0)
+	{
+		u32 Current = Stack[--StackCount];
+		if (Current == PATTERN_NONE || (Set[Current/64] & (1ull << (Current%64))))
+		{
+			continue;
+		}
+		Set[Current/64] |= (1ull << (Current%64));
+
+		pattern_nfa_state *NfaState = &Matcher->Nfa[Current];
+		if (NfaState->Kind == PATTERN_NFA_SPLIT)
+		{
+			Stack[StackCount++] = NfaState->Out[1];
+			Stack[StackCount++] = NfaState->Out[0];
+		}
+		else if (NfaState->Kind == PATTERN_NFA_EMPTY)
+		{
+			Stack[StackCount++] = NfaState->Out[0];
+		}
+	}
+}
+
+internal u32
+PatternSetHash(pattern_matcher *Matcher, u64 *Set)
+{
+	u64 Hash = 14695981039346656037ull;
+	for (u32 Word = 0; Word < Matcher->NfaSetWords; ++Word)
+	{
+		Hash = (Hash ^ Set[Word]) * 1099511628211ull;
+	}
+	return ((u32)(Hash ^ (Hash >> 32)));
+}
+
+internal b32
+PatternSetEqual(pattern_matcher *Matcher, u64 *A, u64 *B)
+{
+	u64 Difference = 0;
+	for (u32 Word = 0; Word < Matcher->NfaSetWords; ++Word)
+	{
+		Difference |= A[Word] ^ B[Word];
+	}
+	return (Difference == 0);
+}
+
+internal u32
+PatternDfaFindOrAdd(pattern_matcher *Matcher, u64 *Set)
+{
+	// NOTE(Felix): Returns PATTERN_NONE if the set is new and the table is full
+	u32 Mask = (u32)ARRAYCOUNT(Matcher->DfaHash) - 1;
+	u32 Slot = PatternSetHash(Matcher, Set) & Mask;
+	for (;;)
+	{
+		u32 Entry = Matcher->DfaHash[Slot];
+		if (Entry == 0)
+		{
+			break;
+		}
+		if (PatternSetEqual(Matcher, Matcher->DfaSets[Entry-1], Set))
+		{
+			return (Entry-1);
+		}
+		Slot = (Slot + 1) & Mask;
+	}
+
+	if (Matcher->DfaCount == PATTERN_MAX_DFA_STATES)
+	{
+		return (PATTERN_NONE);
+	}
+	u32 State = Matcher->DfaCount++;
+	MemoryCopy(Matcher->DfaSets[State], Set, sizeof(u64)*Matcher->NfaSetWords);
+	Matcher->DfaIsMatch[State] = (u8)((Set[Matcher->NfaMatch/64] >> (Matcher->NfaMatch%64)) & 1);
+	for (u32 Class = 0; Class < Matcher->ClassCount; ++Class)
+	{
+		Matcher->Transitions[State*Matcher->ClassCount + Class] = PATTERN_DFA_UNKNOWN;
+	}
+	Matcher->DfaHash[Slot] = (u16)(State+1);
+	return (State);
+}
+
+internal void
+PatternDfaReset(pattern_matcher *Matcher)
+{
+	// NOTE(Felix): Leaves just the dead state (empty set, loops onto itself) and the start state
+	Matcher->DfaCount = 0;
+	MemoryClear(Matcher->DfaHash, sizeof(Matcher->DfaHash));
+
+	u64 Set[PATTERN_NFA_SET_WORDS] = { 0 };
+	u32 Dead = PatternDfaFindOrAdd(Matcher, Set);
+	MemoryClear(&Matcher->Transitions[Dead*Matcher->ClassCount], sizeof(u16)*Matcher->ClassCount);
+
+	PatternAddClosure(Matcher, Set, Matcher->NfaStart);
+	PatternDfaFindOrAdd(Matcher, Set);
+}
+
+internal u32
+PatternDfaStep(pattern_matcher *Matcher, u32 *State, u32 Class)
+{
+	// NOTE(Felix): Works out the transition of *State on Class. If the table is full it gets
+	// flushed first, *State is then renumbered
+	u64 Next[PATTERN_NFA_SET_WORDS] = { 0 };
+	u64 *Current = Matcher->DfaSets[*State];
+	u32 SetWords = Matcher->NfaSetWords;
+	for (u32 Word = 0; Word < SetWords; ++Word)
+	{
+		u64 Bits = Current[Word] & Matcher->ClassAccepts[Class][Word];
+		while (Bits)
+		{
+			u64 *Follow = Matcher->NfaFollow[Word*64 + (u32)__builtin_ctzll(Bits)];
+			Bits &= Bits - 1;
+			for (u32 FollowWord = 0; FollowWord < SetWords; ++FollowWord)
+			{
+				Next[FollowWord] |= Follow[FollowWord];
+			}
+		}
+	}
+
+	u32 Result = PatternDfaFindOrAdd(Matcher, Next);
+	if (Result == PATTERN_NONE)
+	{
+		u64 CurrentCopy[PATTERN_NFA_SET_WORDS];
+		MemoryCopy(CurrentCopy, Current, sizeof(u64)*SetWords);
+		PatternDfaReset(Matcher);
+		++Matcher->DfaFlushCount;
+		*State = PatternDfaFindOrAdd(Matcher, CurrentCopy);
+		Result = PatternDfaFindOrAdd(Matcher, Next);
+	}
+	Matcher->Transitions[*State*Matcher->ClassCount + Class] = (u16)Result;
+	return (Result);
+}
+
+internal void
+PatternCompile(pattern_matcher *Matcher, char *Pattern)
+{
+	Matcher->IsValid = 1;
+	Matcher->AnchoredEnd = 0;
+	Matcher->Source = Pattern;
+	Matcher->SourceLength = StringLength(Pattern);
+	Matcher->Position = 0;
+	Matcher->NfaCount = 0;
+
+	Matcher->IsCaseSensitive = 0;
+	for (u32 Index = 0; Index < Matcher->SourceLength; ++Index)
+	{
+		Matcher->IsCaseSensitive |= (Pattern[Index] >= 'A' && Pattern[Index] <= 'Z');
+	}
+
+	pattern_fragment Body = { 0 };
+	if (Pattern[0] == '^')
+	{
+		++Matcher->Position;
+		Body = PatternParseAlternation(Matcher);
+		if (0 == PatternAtEnd(Matcher))
+		{
+			// NOTE(Felix): Stopped at a ')' without an opening one
+			Matcher->IsValid = 0;
+		}
+	}
+	else
+	{
+		Body = PatternParseGlob(Matcher);
+		Matcher->AnchoredEnd = 1;
+	}
+	Matcher->NfaMatch = PatternNfaAdd(Matcher, PATTERN_NFA_MATCH);
+	PatternPatch(Matcher, Body.Dangling, Matcher->NfaMatch);
+	Matcher->NfaStart = Body.Start;
+	Matcher->Source = 0;
+
+	if (Matcher->IsValid)
+	{
+		PatternComputeByteClasses(Matcher);
+
+		Matcher->NfaSetWords = (Matcher->NfaCount + 63) / 64;
+		MemoryClear(Matcher->ClassAccepts, sizeof(Matcher->ClassAccepts[0])*Matcher->ClassCount);
+		for (u32 State = 0; State < Matcher->NfaCount; ++State)
+		{
+			pattern_nfa_state *NfaState = &Matcher->Nfa[State];
+			if (NfaState->Kind != PATTERN_NFA_CHARS)
+			{
+				continue;
+			}
+			MemoryClear(Matcher->NfaFollow[State], sizeof(Matcher->NfaFollow[0]));
+			PatternAddClosure(Matcher, Matcher->NfaFollow[State], NfaState->Out[0]);
+			for (u32 Byte = 0; Byte < 256; ++Byte)
+			{
+				if (PatternCharsContain(NfaState->Chars, (u8)Byte))
+				{
+					Matcher->ClassAccepts[Matcher->ByteClass[Byte]][State/64] |= (1ull << (State%64));
+				}
+			}
+		}
+		PatternDfaReset(Matcher);
+		Matcher->DfaFlushCount = 0;
+	}
+}
+
+internal b32
+PatternMatchNfa(pattern_matcher *Matcher, char *String, u32 StringLength)
+{
+	// NOTE(Felix): Same as the DFA, just without remembering any state sets
+	u32 SetWords = Matcher->NfaSetWords;
+	u64 Sets[2][PATTERN_NFA_SET_WORDS];
+	u64 *Current = Sets[0];
+	u64 *Next = Sets[1];
+	MemoryCopy(Current, Matcher->DfaSets[PATTERN_DFA_START], sizeof(u64)*SetWords);
+	u32 MatchWord = Matcher->NfaMatch/64;
+	u64 MatchBit = 1ull << (Matcher->NfaMatch%64);
+	for (u32 Index = 0; Index < StringLength; ++Index)
+	{
+		if (0 == Matcher->AnchoredEnd && (Current[MatchWord] & MatchBit))
+		{
+			return (1);
+		}
+
+		u64 *Accepts = Matcher->ClassAccepts[Matcher->ByteClass[(u8)String[Index]]];
+		u64 Any = 0;
+		MemoryClear(Next, sizeof(u64)*SetWords);
+		for (u32 Word = 0; Word < SetWords; ++Word)
+		{
+			u64 Bits = Current[Word] & Accepts[Word];
+			Any |= Bits;
+			while (Bits)
+			{
+				u64 *Follow = Matcher->NfaFollow[Word*64 + (u32)__builtin_ctzll(Bits)];
+				Bits &= Bits - 1;
+				for (u32 FollowWord = 0; FollowWord < SetWords; ++FollowWord)
+				{
+					Next[FollowWord] |= Follow[FollowWord];
+				}
+			}
+		}
+		if (Any == 0)
+		{
+			return (0);
+		}
+		u64 *Swap = Current;
+		Current = Next;
+		Next = Swap;
+	}
+	return ((Current[MatchWord] & MatchBit) != 0);
+}
+
+internal b32
+PatternMatch(pattern_matcher *Matcher, char *String, u32 StringLength)
+{
+	// NOTE(Felix): An invalid pattern matches nothing
+	if (0 == Matcher->IsValid)
+	{
+		return (0);
+	}
+	if (Matcher->DfaFlushCount > PATTERN_MAX_DFA_FLUSHES)
+	{
+		return (PatternMatchNfa(Matcher, String, StringLength));
+	}
+
+	u32 State = PATTERN_DFA_START;
+	for (u32 Index = 0; Index < StringLength; ++Index)
+	{
+		if (0 == Matcher->AnchoredEnd && Matcher->DfaIsMatch[State])
+		{
+			return (1);
+		}
+
+		u32 Class = Matcher->ByteClass[(u8)String[Index]];
+		u32 Next = Matcher->Transitions[State*Matcher->ClassCount + Class];
+		if (Next == PATTERN_DFA_UNKNOWN)
+		{
+			Next = PatternDfaStep(Matcher, &State, Class);
+		}
+		if (Next == PATTERN_DFA_DEAD)
+		{
+			return (0);
+		}
+		State = Next;
+	}
+	return (Matcher->DfaIsMatch[State]);
+}
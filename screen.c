@@ -0,0 +1,318 @@
+#pragma once
+
+// NOTE(Felix): Necessary includes
+// "language_layer.h"
+// "console.c"
+// "arena.c"
+#include <string.h>
+
+// NOTE(Felix): Screen model for differential drawing. A frame gets drawn into Back, one cell
+// per column holding its character (UTF-8) and colours. ScreenFlush compares Back to Front
+// (what the terminal shows right now) and only sends the spans of every row that changed,
+// afterwards the two swap. Changed cells that are only a few unchanged ones apart are sent
+// as one span, repeating those costs less than moving the cursor.
+// Every character takes one column, control characters are shown as '?'.
+// After a resize (or anything else that messed with the terminal) the next flush clears the
+// terminal and sends every cell that isn't blank, see ScreenInvalidate.
+// A frame goes out through Output in one write, see console_output.
+// If the caller knows a part of the screen just moved up or down, ScreenScroll lets the
+// terminal move it instead of sending it all again
+#define SCREEN_MAX_CELLS (1 << 22)
+#define SCREEN_SPAN_MERGE_GAP 4
+
+typedef struct
+{
+	u8 Text[4]; // UTF-8, unused bytes are 0
+	u8 Foreground;
+	u8 Background;
+} screen_cell;
+
+typedef struct
+{
+	i32 Rows;
+	i32 Columns;
+	screen_cell *Front;
+	screen_cell *Back;
+	b32 FrontIsValid;
+
+	// NOTE(Felix): Where and how the frame is drawn right now
+	i32 CursorY;
+	i32 CursorX;
+	u8 Foreground;
+	u8 Background;
+	u8 DefaultForeground;
+	u8 DefaultBackground;
+
+	console_output Output;
+	memory_arena Arena;
+} screen;
+
+internal void
+ScreenInvalidate(screen *Screen)
+{
+	Screen->FrontIsValid = 0;
+}
+
+internal void
+ScreenResize(screen *Screen, i32 Rows, i32 Columns)
+{
+	// NOTE(Felix): Both buffers are pushed anew, the arena reserves enough for the biggest
+	// screen up front. Anything beyond that many cells isn't drawn
+	if (0 == Screen->Arena.Base)
+	{
+		ArenaReserve(&Screen->Arena, 2*sizeof(screen_cell)*SCREEN_MAX_CELLS);
+	}
+	Rows = MAX(Rows, 0);
+	Columns = CLAMP(0, Columns, SCREEN_MAX_CELLS);
+	if ((u64)Rows*(u64)Columns > SCREEN_MAX_CELLS)
+	{
+		Rows = SCREEN_MAX_CELLS / MAX(Columns, 1);
+	}
+
+	u64 CellCount = (u64)Rows*(u64)Columns;
+	ArenaReset(&Screen->Arena);
+	Screen->Front = ArenaPush(&Screen->Arena, sizeof(screen_cell)*CellCount);
+	Screen->Back = ArenaPush(&Screen->Arena, sizeof(screen_cell)*CellCount);
+	Screen->Rows = (Screen->Back) ? Rows : 0;
+	Screen->Columns = (Screen->Back) ? Columns : 0;
+	ScreenInvalidate(Screen);
+}
+
+internal void
+ScreenCellClear(screen_cell *Cell, u8 Foreground, u8 Background)
+{
+	Cell->Text[0] = ' ';
+	Cell->Text[1] = 0;
+	Cell->Text[2] = 0;
+	Cell->Text[3] = 0;
+	Cell->Foreground = Foreground;
+	Cell->Background = Background;
+}
+
+internal b32
+ScreenCellEqual(screen_cell *A, screen_cell *B)
+{
+	return (A->Text[0] == B->Text[0] && A->Text[1] == B->Text[1] &&
+	        A->Text[2] == B->Text[2] && A->Text[3] == B->Text[3] &&
+	        A->Foreground == B->Foreground && A->Background == B->Background);
+}
+
+internal void
+ScreenBeginFrame(screen *Screen, u8 DefaultForeground, u8 DefaultBackground)
+{
+	// NOTE(Felix): The frame starts out blank in the default colours
+	ConsoleOutputFrameBegin(&Screen->Output);
+	Screen->DefaultForeground = DefaultForeground;
+	Screen->DefaultBackground = DefaultBackground;
+	Screen->Foreground = DefaultForeground;
+	Screen->Background = DefaultBackground;
+	Screen->CursorY = 0;
+	Screen->CursorX = 0;
+	i32 CellCount = Screen->Rows*Screen->Columns;
+	for (i32 CellIndex = 0; CellIndex < CellCount; ++CellIndex)
+	{
+		ScreenCellClear(&Screen->Back[CellIndex], DefaultForeground, DefaultBackground);
+	}
+}
+
+internal void
+ScreenMoveTo(screen *Screen, i32 Y, i32 X)
+{
+	Screen->CursorY = Y;
+	Screen->CursorX = X;
+}
+
+internal void
+ScreenColorSet(screen *Screen, u8 Foreground, u8 Background)
+{
+	Screen->Foreground = Foreground;
+	Screen->Background = Background;
+}
+
+internal u8 *
+ScreenDecodeCharacter(u8 *At, u8 *Character)
+{
+	// NOTE(Felix): Reads one UTF-8 character into Character[4], returns where the next one starts
+	u32 Length = 1;
+	if      (*At >= 0xf0) { Length = 4; }
+	else if (*At >= 0xe0) { Length = 3; }
+	else if (*At >= 0xc0) { Length = 2; }
+
+	MemoryClear(Character, 4);
+	Character[0] = *At++;
+	for (u32 Index = 1; Index < Length && (*At & 0xc0) == 0x80; ++Index)
+	{
+		Character[Index] = *At++;
+	}
+	if (Character[0] < 0x20 || Character[0] == 0x7f ||
+	    (Character[0] >= 0x80 && Character[0] < 0xc0))
+	{
+		Character[0] = '?';
+	}
+	return (At);
+}
+
+internal void
+ScreenPutCharacter(screen *Screen, u8 *Character)
+{
+	if (Screen->CursorY >= 0 && Screen->CursorY < Screen->Rows &&
+	    Screen->CursorX >= 0 && Screen->CursorX < Screen->Columns)
+	{
+		screen_cell *Cell = &Screen->Back[Screen->CursorY*Screen->Columns + Screen->CursorX];
+		MemoryCopy(Cell->Text, Character, sizeof(Cell->Text));
+		Cell->Foreground = Screen->Foreground;
+		Cell->Background = Screen->Background;
+	}
+	++Screen->CursorX;
+}
+
+internal void
+ScreenPrint(screen *Screen, char *Text)
+{
+	// NOTE(Felix): Writes Text from the cursor on, whatever doesn't fit into the row is cut off
+	u8 *At = (u8 *)Text;
+	while (*At)
+	{
+		u8 Character[4];
+		At = ScreenDecodeCharacter(At, Character);
+		ScreenPutCharacter(Screen, Character);
+	}
+}
+
+internal void
+ScreenPrintRepeated(screen *Screen, char *Glyph, i32 Count)
+{
+	// NOTE(Felix): For lines of box drawing glyphs, the glyph only gets decoded once
+	u8 Character[4];
+	ScreenDecodeCharacter((u8 *)Glyph, Character);
+	Count = MIN(Count, Screen->Columns - Screen->CursorX);
+	for (i32 Index = 0; Index < Count; ++Index)
+	{
+		ScreenPutCharacter(Screen, Character);
+	}
+}
+
+internal void
+ScreenScroll(screen *Screen, i32 Top, i32 Bottom, i32 Lines)
+{
+	// NOTE(Felix): Rows Top to Bottom (inclusive) of the frame being drawn show what they showed
+	// last frame, moved up by Lines (down if negative). The terminal gets told to scroll them
+	// (DECSTBM and index / reverse index) and Front is moved the same way, so the flush only
+	// has to send the rows that scrolled in and whatever else changed.
+	// Only a hint, the flush fixes up any difference
+	i32 Height = Bottom - Top + 1;
+	if (0 == Screen->FrontIsValid || Lines == 0 || ABS(Lines) >= Height ||
+	    Top < 0 || Bottom >= Screen->Rows)
+	{
+		return;
+	}
+
+	// NOTE(Felix): Scrolled in rows get cleared with the current colours
+	console_output *Output = &Screen->Output;
+	ConsoleOutputColorSet(Output, Screen->DefaultForeground, Screen->DefaultBackground);
+	ConsoleOutputScrollRegionSet(Output, Top, Bottom);
+	ConsoleOutputCursorMoveTo(Output, (Lines > 0) ? Bottom : Top, 0);
+	for (i32 Line = 0; Line < ABS(Lines); ++Line)
+	{
+		if (Lines > 0) { ConsoleOutputIndex(Output); }
+		else           { ConsoleOutputReverseIndex(Output); }
+	}
+	ConsoleOutputScrollRegionReset(Output);
+
+	u64 RowSize = sizeof(screen_cell)*(u64)Screen->Columns;
+	screen_cell *RegionBegin = Screen->Front + Top*Screen->Columns;
+	i32 KeptRows = Height - ABS(Lines);
+	if (Lines > 0)
+	{
+		memmove(RegionBegin, RegionBegin + Lines*Screen->Columns, RowSize*(u64)KeptRows);
+	}
+	else
+	{
+		memmove(RegionBegin - Lines*Screen->Columns, RegionBegin, RowSize*(u64)KeptRows);
+	}
+	i32 ClearedBegin = (Lines > 0) ? (Top + KeptRows) : Top;
+	for (i32 CellIndex = ClearedBegin*Screen->Columns; CellIndex < (ClearedBegin + ABS(Lines))*Screen->Columns; ++CellIndex)
+	{
+		ScreenCellClear(&Screen->Front[CellIndex], Screen->DefaultForeground, Screen->DefaultBackground);
+	}
+}
+
+internal void
+ScreenFlush(screen *Screen)
+{
+	// NOTE(Felix): Sends what changed since the last flush. A cleared terminal is blank in the
+	// default colours, so after an invalidation Front just starts out like that
+	console_output *Output = &Screen->Output;
+	i32 CellCount = Screen->Rows*Screen->Columns;
+	if (0 == Screen->FrontIsValid)
+	{
+		ConsoleOutputColorSet(Output, Screen->DefaultForeground, Screen->DefaultBackground);
+		ConsoleOutputScreenClear(Output);
+		for (i32 CellIndex = 0; CellIndex < CellCount; ++CellIndex)
+		{
+			ScreenCellClear(&Screen->Front[CellIndex], Screen->DefaultForeground, Screen->DefaultBackground);
+		}
+		Screen->FrontIsValid = 1;
+	}
+
+	// NOTE(Felix): Colours and position the terminal is at, -1 if we don't know
+	i32 TerminalForeground = -1;
+	i32 TerminalBackground = -1;
+	i32 TerminalY = -1;
+	i32 TerminalX = -1;
+	for (i32 Y = 0; Y < Screen->Rows; ++Y)
+	{
+		screen_cell *FrontRow = Screen->Front + Y*Screen->Columns;
+		screen_cell *BackRow = Screen->Back + Y*Screen->Columns;
+		i32 X = 0;
+		while (X < Screen->Columns)
+		{
+			if (ScreenCellEqual(&FrontRow[X], &BackRow[X]))
+			{
+				++X;
+				continue;
+			}
+
+			// NOTE(Felix): Span ends once SCREEN_SPAN_MERGE_GAP cells in a row are unchanged
+			i32 SpanBegin = X;
+			i32 SpanEnd = X+1;
+			for (i32 Scan = SpanEnd; Scan < Screen->Columns && Scan < SpanEnd + SCREEN_SPAN_MERGE_GAP; ++Scan)
+			{
+				if (0 == ScreenCellEqual(&FrontRow[Scan], &BackRow[Scan]))
+				{
+					SpanEnd = Scan+1;
+				}
+			}
+
+			if (TerminalY != Y || TerminalX != SpanBegin)
+			{
+				ConsoleOutputCursorMoveTo(Output, Y, SpanBegin);
+			}
+			for (i32 SpanX = SpanBegin; SpanX < SpanEnd; ++SpanX)
+			{
+				screen_cell *Cell = &BackRow[SpanX];
+				if (Cell->Foreground != TerminalForeground || Cell->Background != TerminalBackground)
+				{
+					ConsoleOutputColorSet(Output, Cell->Foreground, Cell->Background);
+					TerminalForeground = Cell->Foreground;
+					TerminalBackground = Cell->Background;
+				}
+				u32 TextLength = 1;
+				while (TextLength < sizeof(Cell->Text) && Cell->Text[TextLength])
+				{
+					++TextLength;
+				}
+				ConsoleOutputAppend(Output, Cell->Text, TextLength);
+			}
+			TerminalY = Y;
+			TerminalX = SpanEnd;
+			X = SpanEnd;
+		}
+	}
+
+	ConsoleOutputFrameEnd(Output);
+
+	screen_cell *Swap = Screen->Front;
+	Screen->Front = Screen->Back;
+	Screen->Back = Swap;
+}
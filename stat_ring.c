@@ -0,0 +1,224 @@
+#pragma once
+
+// NOTE(Felix): Necessary includes
+// "language_layer.h"
+// "metadata_query.c"
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <linux/io_uring.h>
+#include <unistd.h>
+#include <errno.h>
+
+// NOTE(Felix): Batched metadata fetching through io_uring. Up to STAT_RING_ENTRIES statx
+// requests are queued and handed to the kernel with one syscall, which then works on all of
+// them at once. On network filesystems every stat is a round trip, this way they are in
+// flight together instead of one after the other.
+// No liburing, just the raw syscalls and the rings mapped by hand (see io_uring_setup(2)).
+// A ring is only ever used by one thread at a time. If io_uring isn't there (old kernel,
+// disabled through sysctl or seccomp) StatRingCreate fails and callers fetch one entry at a
+// time with EntryStatFetch. A kernel that has io_uring but no statx opcode fails every
+// request with EINVAL, those entries are fetched one at a time as well
+#define STAT_RING_ENTRIES 64
+
+typedef struct
+{
+	i32 FileDescriptor;
+
+	// NOTE(Felix): Submission queue, we write the tail and the kernel the head
+	u32 *SubmissionHead;
+	u32 *SubmissionTail;
+	u32 SubmissionMask;
+	struct io_uring_sqe *SubmissionEntries;
+
+	// NOTE(Felix): Completion queue, the kernel writes the tail and we the head
+	u32 *CompletionHead;
+	u32 *CompletionTail;
+	u32 CompletionMask;
+	struct io_uring_cqe *CompletionEntries;
+
+	void *SubmissionRing;
+	u64 SubmissionRingSize;
+	void *CompletionRing;
+	u64 CompletionRingSize;
+	u64 SubmissionEntriesSize;
+
+	// NOTE(Felix): Requests queued since the last StatRingComplete, by slot
+	u32 QueuedCount;
+	i32 DirectoryFileDescriptor[STAT_RING_ENTRIES];
+	char *Names[STAT_RING_ENTRIES];
+	struct statx Buffers[STAT_RING_ENTRIES];
+} stat_ring;
+
+internal void
+StatRingDestroy(stat_ring *Ring)
+{
+	if (Ring->SubmissionEntries && Ring->SubmissionEntries != MAP_FAILED)
+	{
+		munmap(Ring->SubmissionEntries, Ring->SubmissionEntriesSize);
+	}
+	if (Ring->CompletionRing && Ring->CompletionRing != MAP_FAILED && Ring->CompletionRing != Ring->SubmissionRing)
+	{
+		munmap(Ring->CompletionRing, Ring->CompletionRingSize);
+	}
+	if (Ring->SubmissionRing && Ring->SubmissionRing != MAP_FAILED)
+	{
+		munmap(Ring->SubmissionRing, Ring->SubmissionRingSize);
+	}
+	if (Ring->FileDescriptor > 0)
+	{
+		close(Ring->FileDescriptor);
+	}
+	MemoryClear(Ring, sizeof(*Ring));
+}
+
+internal b32
+StatRingCreate(stat_ring *Ring)
+{
+	// NOTE(Felix): Returns 0 if io_uring can't be used
+	MemoryClear(Ring, sizeof(*Ring));
+	struct io_uring_params Parameters;
+	MemoryClear(&Parameters, sizeof(Parameters));
+	i32 FileDescriptor = (i32)syscall(__NR_io_uring_setup, STAT_RING_ENTRIES, &Parameters);
+	if (FileDescriptor < 0)
+	{
+		return (0);
+	}
+	Ring->FileDescriptor = FileDescriptor;
+
+	// NOTE(Felix): Newer kernels map both queues with one mmap
+	Ring->SubmissionRingSize = Parameters.sq_off.array + Parameters.sq_entries*sizeof(u32);
+	Ring->CompletionRingSize = Parameters.cq_off.cqes + Parameters.cq_entries*sizeof(struct io_uring_cqe);
+	Ring->SubmissionEntriesSize = Parameters.sq_entries*sizeof(struct io_uring_sqe);
+	b32 IsSingleMapping = (Parameters.features & IORING_FEAT_SINGLE_MMAP) != 0;
+	if (IsSingleMapping)
+	{
+		Ring->SubmissionRingSize = MAX(Ring->SubmissionRingSize, Ring->CompletionRingSize);
+		Ring->CompletionRingSize = Ring->SubmissionRingSize;
+	}
+
+	Ring->SubmissionRing = mmap(0, Ring->SubmissionRingSize, PROT_READ|PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+	                            FileDescriptor, IORING_OFF_SQ_RING);
+	Ring->CompletionRing = IsSingleMapping ? Ring->SubmissionRing :
+		mmap(0, Ring->CompletionRingSize, PROT_READ|PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+		     FileDescriptor, IORING_OFF_CQ_RING);
+	Ring->SubmissionEntries = mmap(0, Ring->SubmissionEntriesSize, PROT_READ|PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+	                               FileDescriptor, IORING_OFF_SQES);
+	if (Ring->SubmissionRing == MAP_FAILED || Ring->CompletionRing == MAP_FAILED ||
+	    Ring->SubmissionEntries == MAP_FAILED)
+	{
+		StatRingDestroy(Ring);
+		return (0);
+	}
+
+	u8 *Submission = Ring->SubmissionRing;
+	u8 *Completion = Ring->CompletionRing;
+	Ring->SubmissionHead = (u32 *)(void *)(Submission + Parameters.sq_off.head);
+	Ring->SubmissionTail = (u32 *)(void *)(Submission + Parameters.sq_off.tail);
+	Ring->SubmissionMask = *(u32 *)(void *)(Submission + Parameters.sq_off.ring_mask);
+	Ring->CompletionHead = (u32 *)(void *)(Completion + Parameters.cq_off.head);
+	Ring->CompletionTail = (u32 *)(void *)(Completion + Parameters.cq_off.tail);
+	Ring->CompletionMask = *(u32 *)(void *)(Completion + Parameters.cq_off.ring_mask);
+	Ring->CompletionEntries = (struct io_uring_cqe *)(void *)(Completion + Parameters.cq_off.cqes);
+
+	// NOTE(Felix): Submission entry i always sits in slot i of the array
+	u32 *SubmissionArray = (u32 *)(void *)(Submission + Parameters.sq_off.array);
+	for (u32 Index = 0; Index < Parameters.sq_entries; ++Index)
+	{
+		SubmissionArray[Index] = Index;
+	}
+	return (1);
+}
+
+internal b32
+StatRingQueue(stat_ring *Ring, i32 DirectoryFileDescriptor, char *Name)
+{
+	// NOTE(Felix): Name has to stay around until StatRingComplete. Returns 0 if the ring is full
+	if (Ring->QueuedCount == STAT_RING_ENTRIES)
+	{
+		return (0);
+	}
+	u32 Slot = Ring->QueuedCount++;
+	Ring->DirectoryFileDescriptor[Slot] = DirectoryFileDescriptor;
+	Ring->Names[Slot] = Name;
+	return (1);
+}
+
+internal b32
+StatRingComplete(stat_ring *Ring, entry_stat *Stats, b32 *Fetched)
+{
+	// NOTE(Felix): Submits everything queued and waits for all of it. Results land in the
+	// slot (order) the requests were queued in. Returns 0 if the ring broke down, everything
+	// was fetched one at a time then and the ring has to be destroyed
+	u32 Count = Ring->QueuedCount;
+	Ring->QueuedCount = 0;
+
+	u32 Tail = *Ring->SubmissionTail;
+	for (u32 Slot = 0; Slot < Count; ++Slot)
+	{
+		struct io_uring_sqe *Entry = &Ring->SubmissionEntries[(Tail + Slot) & Ring->SubmissionMask];
+		MemoryClear(Entry, sizeof(*Entry));
+		Entry->opcode = IORING_OP_STATX;
+		Entry->fd = Ring->DirectoryFileDescriptor[Slot];
+		Entry->addr = (u64)(uintptr_t)Ring->Names[Slot];
+		Entry->len = STATX_TYPE | STATX_MODE | STATX_SIZE | STATX_MTIME | STATX_UID;
+		Entry->off = (u64)(uintptr_t)&Ring->Buffers[Slot];
+		Entry->statx_flags = AT_SYMLINK_NOFOLLOW;
+		Entry->user_data = Slot;
+		Fetched[Slot] = 0;
+	}
+	__atomic_store_n(Ring->SubmissionTail, Tail + Count, __ATOMIC_RELEASE);
+
+	u32 ToSubmit = Count;
+	u32 CompletedCount = 0;
+	while (CompletedCount < Count)
+	{
+		long Result = syscall(__NR_io_uring_enter, Ring->FileDescriptor, ToSubmit, Count - CompletedCount,
+		                      IORING_ENTER_GETEVENTS, 0, 0);
+		if (Result < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			// NOTE(Felix): Whatever didn't complete gets fetched one at a time below
+			break;
+		}
+		ToSubmit -= MIN(ToSubmit, (u32)Result);
+
+		u32 Head = *Ring->CompletionHead;
+		u32 CompletionTail = __atomic_load_n(Ring->CompletionTail, __ATOMIC_ACQUIRE);
+		for (; Head != CompletionTail; ++Head)
+		{
+			struct io_uring_cqe *Completion = &Ring->CompletionEntries[Head & Ring->CompletionMask];
+			u32 Slot = (u32)Completion->user_data;
+			if (Slot < Count)
+			{
+				struct statx *Buffer = &Ring->Buffers[Slot];
+				if (Completion->res == 0)
+				{
+					Stats[Slot].Size = Buffer->stx_size;
+					Stats[Slot].ModifiedTime = Buffer->stx_mtime.tv_sec;
+					Stats[Slot].Mode = Buffer->stx_mode;
+					Stats[Slot].Owner = Buffer->stx_uid;
+					Fetched[Slot] = 1;
+				}
+				else if (Completion->res == -EINVAL || Completion->res == -EOPNOTSUPP)
+				{
+					Fetched[Slot] = EntryStatFetch(&Stats[Slot], Ring->DirectoryFileDescriptor[Slot], Ring->Names[Slot]);
+				}
+				++CompletedCount;
+			}
+		}
+		__atomic_store_n(Ring->CompletionHead, Head, __ATOMIC_RELEASE);
+	}
+
+	if (CompletedCount < Count)
+	{
+		for (u32 Slot = 0; Slot < Count; ++Slot)
+		{
+			Fetched[Slot] = EntryStatFetch(&Stats[Slot], Ring->DirectoryFileDescriptor[Slot], Ring->Names[Slot]);
+		}
+		return (0);
+	}
+	return (1);
+}
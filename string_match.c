@@ -0,0 +1,309 @@
+#pragma once
+
+// NOTE(Felix): Necessary includes
+// "language_layer.h"
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// NOTE(Felix): Substring search for filtering. Answers the same question as StringContains
+// (which stays around as the reference), but the search term is prepared once up front and
+// the length of the searched string has to be known already.
+// The vector versions check 16 (SSE2) or 32 (AVX2) starting positions at once: a position
+// is only a candidate if both the first and the last byte of the term match there, just
+// the bytes in between get compared one by one. Letters are folded to lower case in register.
+// AVX2 is picked at runtime if the CPU has it, SSE2 is always there on x86-64.
+// SubstringMatchScalar is the fallback elsewhere and what "--substring-test" checks the
+// vector versions against (see SubstringMatchTestRun).
+//
+// The vector versions may read up to STRING_MATCH_READ_PADDING bytes past the end of the
+// searched string (the result never depends on them), so whatever holds the strings has
+// to keep that many bytes behind every string readable.
+#define STRING_MATCH_MAX_TERM_LENGTH 256
+#define STRING_MATCH_READ_PADDING 32
+
+typedef struct substring_matcher substring_matcher;
+typedef b32 substring_match_function(substring_matcher *Matcher, char *String, u32 StringLength);
+
+struct substring_matcher
+{
+	u8 Term[STRING_MATCH_MAX_TERM_LENGTH]; // Already folded if case insensitive
+	u32 TermLength;
+	b32 IsCaseSensitive;
+	substring_match_function *Match;
+};
+
+internal u8
+StringMatchFoldChar(u8 Char, b32 IsCaseSensitive)
+{
+	return (IsCaseSensitive ? Char : (u8)CharToLowerIfIsLetter((char)Char));
+}
+
+internal b32
+StringMatchCompareInner(substring_matcher *Matcher, u8 *Candidate)
+{
+	// NOTE(Felix): First and last byte are already known to match
+	for (u32 Index = 1; Index+1 < Matcher->TermLength; ++Index)
+	{
+		if (StringMatchFoldChar(Candidate[Index], Matcher->IsCaseSensitive) != Matcher->Term[Index])
+		{
+			return (0);
+		}
+	}
+	return (1);
+}
+
+internal b32
+SubstringMatchScalar(substring_matcher *Matcher, char *String, u32 StringLength)
+{
+	u32 TermLength = Matcher->TermLength;
+	for (u32 Position = 0; Position + TermLength <= StringLength; ++Position)
+	{
+		u32 MatchingCount = 0;
+		while (MatchingCount < TermLength &&
+		       StringMatchFoldChar((u8)String[Position+MatchingCount], Matcher->IsCaseSensitive) == Matcher->Term[MatchingCount])
+		{
+			++MatchingCount;
+		}
+		if (MatchingCount == TermLength)
+		{
+			return (1);
+		}
+	}
+	return (0);
+}
+
+#if defined(__SSE2__)
+internal __m128i
+StringMatchFold16(__m128i Bytes, __m128i FoldMask)
+{
+	// NOTE(Felix): Moves 'A' to the bottom of the signed range, so one compare finds 'A'..'Z'
+	__m128i Shifted = _mm_add_epi8(Bytes, _mm_set1_epi8((char)(0x80 - 'A')));
+	__m128i IsUpper = _mm_cmplt_epi8(Shifted, _mm_set1_epi8(-128 + 26));
+	return (_mm_or_si128(Bytes, _mm_and_si128(IsUpper, FoldMask)));
+}
+
+internal b32
+SubstringMatchSSE2(substring_matcher *Matcher, char *String, u32 StringLength)
+{
+	u32 TermLength = Matcher->TermLength;
+	if (TermLength == 0 || TermLength > StringLength)
+	{
+		return (TermLength == 0);
+	}
+
+	__m128i FoldMask = _mm_set1_epi8(Matcher->IsCaseSensitive ? 0 : 0x20);
+	__m128i First = _mm_set1_epi8((char)Matcher->Term[0]);
+	__m128i Last = _mm_set1_epi8((char)Matcher->Term[TermLength-1]);
+	u32 PositionCount = StringLength - TermLength + 1;
+	for (u32 Position = 0; Position < PositionCount; Position += 16)
+	{
+		__m128i BlockFirst = StringMatchFold16(_mm_loadu_si128((__m128i *)(void *)(String + Position)), FoldMask);
+		__m128i BlockLast = StringMatchFold16(_mm_loadu_si128((__m128i *)(void *)(String + Position + TermLength-1)), FoldMask);
+		__m128i Both = _mm_and_si128(_mm_cmpeq_epi8(BlockFirst, First), _mm_cmpeq_epi8(BlockLast, Last));
+		u32 Candidates = (u32)_mm_movemask_epi8(Both);
+		if (PositionCount - Position < 16)
+		{
+			Candidates &= (1u << (PositionCount - Position)) - 1;
+		}
+
+		while (Candidates)
+		{
+			u32 Offset = (u32)__builtin_ctz(Candidates);
+			if (StringMatchCompareInner(Matcher, (u8 *)String + Position + Offset))
+			{
+				return (1);
+			}
+			Candidates &= Candidates - 1;
+		}
+	}
+	return (0);
+}
+
+__attribute__((target("avx2"))) internal __m256i
+StringMatchFold32(__m256i Bytes, __m256i FoldMask)
+{
+	__m256i Shifted = _mm256_add_epi8(Bytes, _mm256_set1_epi8((char)(0x80 - 'A')));
+	__m256i IsUpper = _mm256_cmpgt_epi8(_mm256_set1_epi8(-128 + 26), Shifted);
+	return (_mm256_or_si256(Bytes, _mm256_and_si256(IsUpper, FoldMask)));
+}
+
+__attribute__((target("avx2"))) internal b32
+SubstringMatchAVX2(substring_matcher *Matcher, char *String, u32 StringLength)
+{
+	u32 TermLength = Matcher->TermLength;
+	if (TermLength == 0 || TermLength > StringLength)
+	{
+		return (TermLength == 0);
+	}
+
+	__m256i FoldMask = _mm256_set1_epi8(Matcher->IsCaseSensitive ? 0 : 0x20);
+	__m256i First = _mm256_set1_epi8((char)Matcher->Term[0]);
+	__m256i Last = _mm256_set1_epi8((char)Matcher->Term[TermLength-1]);
+	u32 PositionCount = StringLength - TermLength + 1;
+	for (u32 Position = 0; Position < PositionCount; Position += 32)
+	{
+		__m256i BlockFirst = StringMatchFold32(_mm256_loadu_si256((__m256i *)(void *)(String + Position)), FoldMask);
+		__m256i BlockLast = StringMatchFold32(_mm256_loadu_si256((__m256i *)(void *)(String + Position + TermLength-1)), FoldMask);
+		__m256i Both = _mm256_and_si256(_mm256_cmpeq_epi8(BlockFirst, First), _mm256_cmpeq_epi8(BlockLast, Last));
+		u32 Candidates = (u32)_mm256_movemask_epi8(Both);
+		if (PositionCount - Position < 32)
+		{
+			Candidates &= (1u << (PositionCount - Position)) - 1;
+		}
+
+		while (Candidates)
+		{
+			u32 Offset = (u32)__builtin_ctz(Candidates);
+			if (StringMatchCompareInner(Matcher, (u8 *)String + Position + Offset))
+			{
+				return (1);
+			}
+			Candidates &= Candidates - 1;
+		}
+	}
+	return (0);
+}
+#endif
+
+internal void
+SubstringMatcherInit(substring_matcher *Matcher, char *SearchTerm, b32 IsCaseSensitive)
+{
+	u32 TermLength = MIN(StringLength(SearchTerm), STRING_MATCH_MAX_TERM_LENGTH-1);
+	for (u32 Index = 0; Index < TermLength; ++Index)
+	{
+		Matcher->Term[Index] = StringMatchFoldChar((u8)SearchTerm[Index], IsCaseSensitive);
+	}
+	Matcher->Term[TermLength] = 0;
+	Matcher->TermLength = TermLength;
+	Matcher->IsCaseSensitive = IsCaseSensitive;
+
+#if defined(__SSE2__)
+	Matcher->Match = __builtin_cpu_supports("avx2") ? SubstringMatchAVX2 : SubstringMatchSSE2;
+#else
+	Matcher->Match = SubstringMatchScalar;
+#endif
+}
+
+internal b32
+SubstringMatch(substring_matcher *Matcher, char *String, u32 StringLength)
+{
+	return (Matcher->Match(Matcher, String, StringLength));
+}
+
+#define SUBSTRING_MATCH_TEST_CASE_COUNT (1u << 22)
+#define SUBSTRING_MATCH_TEST_MAX_STRING_LENGTH 300
+
+internal u32
+SubstringMatchTestRandom(u64 *State)
+{
+	// NOTE(Felix): xorshift64
+	*State ^= *State << 13;
+	*State ^= *State >> 7;
+	*State ^= *State << 17;
+	return ((u32)(*State >> 32));
+}
+
+internal b32
+SubstringMatchTestRun(void)
+{
+	// NOTE(Felix): "--substring-test": random strings and terms, every vector version has to
+	// agree with SubstringMatchScalar. The alphabet is small so terms actually occur, and has
+	// the bytes right around the letters so folding gets checked too. Most strings end exactly
+	// STRING_MATCH_READ_PADDING bytes in front of a page that can't be read, so a version 
+	// reading too far crashes here instead of in the wild. The seed is fixed, so a failure
+	// comes back on the next run.
+	char Alphabet[] = "aAbBzZ@[`{.\x80\xc1\xe1\xff";
+	u32 AlphabetSize = (u32)sizeof(Alphabet) - 1;
+	u64 Random = 0x9E3779B97F4A7C15ull;
+
+	u64 PageSize = (u64)sysconf(_SC_PAGESIZE);
+	u64 BufferSize = ((SUBSTRING_MATCH_TEST_MAX_STRING_LENGTH + STRING_MATCH_READ_PADDING + PageSize-1) / PageSize) * PageSize;
+	u8 *Buffer = mmap(0, BufferSize + PageSize, PROT_READ|PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (Buffer == MAP_FAILED || mprotect(Buffer + BufferSize, PageSize, PROT_NONE) != 0)
+	{
+		fprintf(stderr, "Couldn't allocate the substring test\n");
+		return (0);
+	}
+
+	char *Names[] = { "scalar", "SSE2", "AVX2" };
+	substring_match_function *Functions[ARRAYCOUNT(Names)] = { &SubstringMatchScalar };
+	u32 FunctionCount = 1;
+#if defined(__SSE2__)
+	Functions[FunctionCount++] = &SubstringMatchSSE2;
+	if (__builtin_cpu_supports("avx2"))
+	{
+		Functions[FunctionCount++] = &SubstringMatchAVX2;
+	}
+#endif
+
+	u64 MatchCount = 0;
+	u64 MismatchCount[ARRAYCOUNT(Names)] = { 0 };
+	for (u32 CaseIndex = 0; CaseIndex < SUBSTRING_MATCH_TEST_CASE_COUNT; ++CaseIndex)
+	{
+		u32 Bits = SubstringMatchTestRandom(&Random);
+		u32 Length = SubstringMatchTestRandom(&Random) % (SUBSTRING_MATCH_TEST_MAX_STRING_LENGTH + 1);
+		if (Bits & 1)
+		{
+			Length %= 40;
+		}
+		u32 PaddingFree = (Bits & 6) ? 0 : (Bits >> 24) % 64;
+		char *String = (char *)Buffer + BufferSize - STRING_MATCH_READ_PADDING - PaddingFree - Length;
+		for (u8 *Byte = (u8 *)String; Byte < Buffer + BufferSize; ++Byte)
+		{
+			*Byte = (u8)Alphabet[SubstringMatchTestRandom(&Random) % AlphabetSize];
+		}
+
+		// NOTE(Felix): Half of the terms are taken from the string, with the case scrambled
+		char Term[STRING_MATCH_MAX_TERM_LENGTH] = { 0 };
+		u32 TermLength = (Bits >> 3) % ((Bits & (1 << 12)) ? 40 : 6);
+		u32 CaseBits = SubstringMatchTestRandom(&Random);
+		if ((Bits & (1 << 13)) && TermLength <= Length)
+		{
+			u32 TermStart = (Bits >> 14) % (Length - TermLength + 1);
+			for (u32 Index = 0; Index < TermLength; ++Index)
+			{
+				char Char = String[TermStart + Index];
+				Term[Index] = ((CaseBits >> (Index % 32)) & 1) ? CharToLowerIfIsLetter(Char) : Char;
+			}
+		}
+		else
+		{
+			for (u32 Index = 0; Index < TermLength; ++Index)
+			{
+				Term[Index] = Alphabet[SubstringMatchTestRandom(&Random) % AlphabetSize];
+			}
+		}
+
+		substring_matcher Matcher = { 0 };
+		SubstringMatcherInit(&Matcher, Term, (Bits >> 30) & 1);
+		b32 Expected = SubstringMatchScalar(&Matcher, String, Length);
+		MatchCount += (Expected ? 1 : 0);
+		for (u32 FunctionIndex = 1; FunctionIndex < FunctionCount; ++FunctionIndex)
+		{
+			if ((0 != Functions[FunctionIndex](&Matcher, String, Length)) != (0 != Expected))
+			{
+				if (0 == MismatchCount[FunctionIndex])
+				{
+					printf("%s disagrees: term \"%s\" (%s) in \"%.*s\"\n", Names[FunctionIndex], Term,
+					       Matcher.IsCaseSensitive ? "case sensitive" : "case insensitive", (i32)Length, String);
+				}
+				++MismatchCount[FunctionIndex];
+			}
+		}
+	}
+
+	b32 IsOk = 1;
+	printf("%" PFu32 " cases, %" PFu64 " matches\n", SUBSTRING_MATCH_TEST_CASE_COUNT, MatchCount);
+	for (u32 FunctionIndex = 1; FunctionIndex < FunctionCount; ++FunctionIndex)
+	{
+		printf("%-6s %" PFu64 " disagreements with scalar\n", Names[FunctionIndex], MismatchCount[FunctionIndex]);
+		IsOk = IsOk && (0 == MismatchCount[FunctionIndex]);
+	}
+	printf("%s\n", IsOk ? "OK" : "FAILED");
+	munmap(Buffer, BufferSize + PageSize);
+	return (IsOk);
+}